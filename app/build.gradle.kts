@@ -2,6 +2,9 @@ plugins {
     id("com.android.application")
 }
 
+val assetsDir = file("src/main/assets")
+val assetsBundle = assetsDir.resolve("assets.bundle")
+
 android {
     /*sourceSets["main"].assets.srcDir(
         layout.buildDirectory.dir("generated/assets")
@@ -12,6 +15,18 @@ android {
         useLegacyPackaging = true
       }
     }
+    // assets.bundle (tools/mkbundle) is viewed in place; a compressed entry
+    // would be inflated into memory instead. It packs every file under
+    // src/main/assets, so once it exists the loose copies stay out of the APK
+    // and startup opens that one file.
+    androidResources {
+        noCompress += "bundle"
+        if (assetsBundle.exists()) {
+            assetsDir.listFiles()?.filter { it != assetsBundle }?.forEach {
+                ignoreAssetsPatterns += (if (it.isDirectory) "!<dir>" else "!<file>") + it.name
+            }
+        }
+    }
     namespace = "com.example.egl"
     compileSdk = 35
     ndkVersion = "27.1.12297006"
@@ -48,6 +63,27 @@ android {
     }
 }
 
+// Fails the build when a file under src/main/assets is newer than
+// assets.bundle: the APK only ships the bundle, so an edit would be lost
+// until tools/mkbundle is rerun.
+val checkAssetsBundle = tasks.register("checkAssetsBundle") {
+    val dir = assetsDir
+    val bundle = assetsBundle
+    doLast {
+        if (!bundle.exists()) return@doLast
+        val newer = dir.walkTopDown()
+            .filter { it.isFile && it != bundle && it.lastModified() > bundle.lastModified() }
+            .map { it.relativeTo(dir).invariantSeparatorsPath }
+            .toList()
+        if (newer.isNotEmpty()) {
+            throw GradleException("assets.bundle is older than ${newer.joinToString()}; rerun tools/mkbundle")
+        }
+    }
+}
+tasks.named("preBuild").configure {
+    dependsOn(checkAssetsBundle)
+}
+
 //val FONT_NAME: String = project.findProperty("FONT_NAME") as String? ?: "Roboto-Regular.ttf"
 /*val fontName = providers.gradleProperty("FONT_NAME")
     .orElse("Roboto-Regular.ttf")
@@ -4,13 +4,21 @@
 precision highp float;
 
 uniform sampler2D uTex;
+uniform vec4 uClip;     // x0 y0 x1 y1, screen space
+uniform float uOpacity;
 
 in vec2 vUV;
 in vec4 vColor;
+in vec2 vWorld;
 
 out vec4 fragColor;
 
 void main() {
     float a = texture(uTex, vUV).r;  // atlas stored in R8/RED
-    fragColor = vec4(vColor.rgb, vColor.a * a);
+
+    vec2 cd = min(vWorld - uClip.xy, uClip.zw - vWorld);
+    float clipMask = clamp(min(cd.x, cd.y) + 0.5, 0.0, 1.0);
+    if (clipMask <= 0.0) discard;
+
+    fragColor = vec4(vColor.rgb, vColor.a * a * clipMask * uOpacity);
 }
\ No newline at end of file
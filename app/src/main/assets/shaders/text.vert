@@ -5,6 +5,8 @@ precision highp float;
 
 uniform mat4 uMVP;
 uniform vec2 uTranslate;
+uniform vec4 uXfM;      // shared XformTable slot: mat2(a b c d)
+uniform vec2 uXfT;      // tx ty
 
 layout(location=0) in vec2 aPos;
 layout(location=1) in vec2 aUV;
@@ -12,10 +14,18 @@ layout(location=2) in vec4 aColor;   // GL_UNSIGNED_BYTE normalized -> 0..1
 
 out vec2 vUV;
 out vec4 vColor;
+out vec2 vWorld;
 
 void main() {
     vUV = aUV;
     vColor = aColor;
-    vec2 p = aPos + uTranslate;
+#ifdef TEXT_LINEAR_COLOR
+    // sRGB framebuffer: convert vertex colors to linear light
+    vec3 lo = aColor.rgb * (1.0 / 12.92);
+    vec3 hi = pow((aColor.rgb + 0.055) * (1.0 / 1.055), vec3(2.4));
+    vColor.rgb = mix(hi, lo, lessThanEqual(aColor.rgb, vec3(0.04045)));
+#endif
+    vec2 p = mat2(uXfM.xy, uXfM.zw) * (aPos + uTranslate) + uXfT;
+    vWorld = p;
     gl_Position = uMVP * vec4(p, 0.0, 1.0);
 }
\ No newline at end of file
@@ -1,5 +1,15 @@
 #version 300 es
 
+// Built three times by UiRenderer:
+//   (none)              - general SDF path, every UiShape
+//   UI_VARIANT_SOLID    - pixel-aligned square rect, one color
+//   UI_VARIANT_GRADIENT - pixel-aligned square rect, bilinear corner colors
+// The fast variants still apply the clip rect and opacity.
+// UI_COLOR_F16 / UI_SRGB_TARGET: see ui.vert. Colors arrive linear when either is set.
+#if defined(UI_COLOR_F16) || defined(UI_SRGB_TARGET)
+#define UI_COLOR_LINEAR 1
+#endif
+
 precision highp float;
 precision highp int;
 precision highp usampler2D;
@@ -8,6 +18,11 @@ in vec2 vLocal;
 in vec2 vHalf;
 in float vRadius;
 in float vFeather;
+in float vStroke;
+flat in uint vShape;
+flat in vec4 vClip;
+flat in float vOpacity;
+in vec2 vWorld;
 
 in vec4 vTL;
 in vec4 vTR;
@@ -16,31 +31,90 @@ in vec4 vBL;
 
 out vec4 fragColor;
 
-vec3 srgbToLinear(vec3 c) { return pow(c, vec3(2.2)); }
-vec3 linearToSrgb(vec3 c) { return pow(c, vec3(1.0/2.2)); }
+// clip rect: full coverage inside, one pixel ramp at its edges
+float clipCoverage() {
+    vec2 cd = min(vWorld - vClip.xy, vClip.zw - vWorld);
+    return clamp(min(cd.x, cd.y) + 0.5, 0.0, 1.0);
+}
+
+vec4 cornerColor() {
+    // map local [-half..half] -> uv [0..1]
+    vec2 uv = vLocal / max(vHalf, vec2(1e-6));
+    uv = uv * 0.5 + 0.5;
+
+    vec4 top = mix(vTL, vTR, uv.x);
+    vec4 bot = mix(vBL, vBR, uv.x);
+    return mix(top, bot, uv.y);
+}
+
+// straight color c, final alpha a -> premultiplied output for the bound framebuffer
+vec4 premulOut(vec3 c, float a) {
+#if defined(UI_SRGB_TARGET)
+    return vec4(c * a, a);                          // hardware encodes on write
+#elif defined(UI_COLOR_LINEAR)
+    vec3 l = c * a;                                 // exact sRGB encode
+    vec3 lo = l * 12.92;
+    vec3 hi = 1.055 * pow(l, vec3(1.0 / 2.4)) - 0.055;
+    return vec4(mix(hi, lo, lessThanEqual(l, vec3(0.0031308))), a);
+#else
+    // sRGB in and out, premultiplied in (2.2-gamma) linear:
+    // pow(pow(c, 2.2) * a, 1/2.2) == c * pow(a, 1/2.2)
+    return vec4(c * pow(a, 1.0 / 2.2), a);
+#endif
+}
+
+// UiShape
+#define UI_SHAPE_RECT        0u
+#define UI_SHAPE_SEGMENT     1u
+#define UI_SHAPE_CIRCLE      2u
+#define UI_SHAPE_RING        3u
+#define UI_SHAPE_RECT_STROKE 4u
 
 float sdRoundBox(vec2 p, vec2 b, float r) {
     vec2 q = abs(p) - (b - vec2(r));
     return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;
 }
 
-void main() {
+float shapeDist() {
+    if (vShape == UI_SHAPE_CIRCLE) {
+        return length(vLocal) - vHalf.x;
+    }
+    if (vShape == UI_SHAPE_RING) {
+        float t = 0.5 * min(vStroke, vHalf.x);
+        return abs(length(vLocal) - (vHalf.x - t)) - t;
+    }
+    if (vShape == UI_SHAPE_RECT_STROKE) {
+        // stroke lies inside the rect: centerline box inset by half the width
+        float t = 0.5 * min(vStroke, min(vHalf.x, vHalf.y));
+        vec2  b = vHalf - vec2(t);
+        float r = clamp(vRadius - t, 0.0, min(b.x, b.y));
+        return abs(sdRoundBox(vLocal, b, r)) - t;
+    }
+    // UI_SHAPE_RECT, UI_SHAPE_SEGMENT (local frame already follows the segment)
     float r = clamp(vRadius, 0.0, min(vHalf.x, vHalf.y));
-    float d = sdRoundBox(vLocal, vHalf, r);
+    return sdRoundBox(vLocal, vHalf, r);
+}
 
-    float aa = max(vFeather, fwidth(d));
-    float aMask = smoothstep(aa, 0.0, d);
+#if defined(UI_VARIANT_SOLID)
+void main() {
+    fragColor = premulOut(vTL.rgb, vTL.a * clipCoverage() * vOpacity);
+}
+#elif defined(UI_VARIANT_GRADIENT)
+void main() {
+    vec4 c = cornerColor();
+    fragColor = premulOut(c.rgb, c.a * clipCoverage() * vOpacity);
+}
+#else
+void main() {
+    float d = shapeDist();
+    float aa = max(vFeather, fwidth(d)); // derivatives before any discard
 
-    // map local [-half..half] -> uv [0..1]
-    vec2 uv = vLocal / max(vHalf, vec2(1e-6));
-    uv = uv * 0.5 + 0.5;
+    float clipMask = clipCoverage();
+    if (clipMask <= 0.0) discard;
 
-    vec4 top = mix(vTL, vTR, uv.x);
-    vec4 bot = mix(vBL, vBR, uv.x);
-    vec4 c   = mix(top, bot, uv.y);
+    float aMask = smoothstep(aa, 0.0, d) * clipMask * vOpacity;
 
-    vec3 rgbLin = srgbToLinear(c.rgb);
-    float outA = c.a * aMask;
-    vec3 outRgbLin = rgbLin * outA;
-    fragColor = vec4(linearToSrgb(outRgbLin), outA);
-}
\ No newline at end of file
+    vec4 c = cornerColor();
+    fragColor = premulOut(c.rgb, c.a * aMask);
+}
+#endif
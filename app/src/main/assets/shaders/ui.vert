@@ -1,68 +1,199 @@
 #version 300 es
 
+// Instance data is UiInstGpu (32 bytes: 20.4 fixed center with shape/feather and
+// state index in the top bytes, fp16 half/radius/stroke, 4x RGBA8). UiRenderer replaces the #version line and defines one of:
+//   UI_INST_TEX  - RGBA32UI instance texture, 2 texels/instance (default when nothing is defined)
+//   UI_INST_ATTR - per-instance vertex attributes (glVertexAttribDivisor)
+//   UI_INST_SSBO - std430 UiInstGpu[] storage buffer (needs #version 310 es)
+// plus the ui.frag variant (UI_VARIANT_SOLID / UI_VARIANT_GRADIENT) being paired with, and
+//   UI_COLOR_F16   - corner colors are linear fp16 (UiInstGpuF16, 48 bytes) instead of sRGB RGBA8
+//   UI_SRGB_TARGET - the framebuffer encodes sRGB; RGBA8 corners are linearized here, per vertex
+#if !defined(UI_INST_ATTR) && !defined(UI_INST_SSBO)
+#define UI_INST_TEX 1
+#endif
+
 precision highp float;
 precision highp int;
 precision highp usampler2D;
 
+// UiShape (see ui.frag for the full list)
+#define UI_SHAPE_SEGMENT     1u
+
 layout(location=0) in vec2 aCorner; // -1..1 unit quad
 
 uniform mat4 uMVP;
-
-// Float instance texture: RGBA16F or RGBA32F
-uniform sampler2D  uInstF;
-uniform int        uInstF_W;   // width in texels
-
-// Color instance texture: RGBA8UI
-uniform usampler2D uInstU;
-uniform int        uInstU_W;   // width in texels
+#if !defined(UI_INST_ATTR)
+uniform int uInstBase;  // first instance of this draw (attribs are offset on the CPU instead)
+#endif
+
+#if defined(UI_INST_TEX)
+// Instance texture: RGBA32UI, raw UiInstGpu words
+uniform usampler2D uInst;
+uniform int        uInst_W;    // width in texels
+#elif defined(UI_INST_ATTR)
+layout(location=1) in uvec2 aPos;    // cxShape cyState
+layout(location=2) in vec4 aHalfRad; // hx hy radius stroke (fp16 in the buffer)
+layout(location=3) in vec4 aTL;      // RGBA8 normalized, or fp16 (UI_COLOR_F16), by the vertex fetch
+layout(location=4) in vec4 aTR;
+layout(location=5) in vec4 aBR;
+layout(location=6) in vec4 aBL;
+#elif defined(UI_INST_SSBO)
+struct UiInstGpu {
+    uvec2 pos;      // cxShape cyState
+    uvec2 hr;       // fp16 pairs: (hx, hy) (radius, stroke)
+#if defined(UI_COLOR_F16)
+    uvec4 colA;     // fp16 pairs: tl.rg tl.ba tr.rg tr.ba
+    uvec4 colB;     //             br.rg br.ba bl.rg bl.ba
+#else
+    uvec4 col;      // packed RGBA8 tl tr br bl
+#endif
+};
+layout(std430, binding=0) readonly buffer UiInstBuf {
+    UiInstGpu uInst[];
+};
+#endif
+
+// UiRenderer state table, entry 0 = unclipped + identity transform
+layout(std140) uniform UiStateBlock {
+    vec4  uStateClip[256];  // ClipRect x0 y0 x1 y1
+    uvec4 uStateXf[64];     // transform slot per state, 4 states per uvec4
+};
+// XformTable slots: (a b c d) (tx ty opacity _)
+layout(std140) uniform UiXformBlock {
+    vec4 uXform[512];
+};
 
 out vec2 vLocal;
 out vec2 vHalf;
 out float vRadius;
 out float vFeather;
+out float vStroke;
+flat out uint vShape;
+flat out vec4 vClip;
+flat out float vOpacity;
+out vec2 vWorld;
 
 out vec4 vTL;
 out vec4 vTR;
 out vec4 vBR;
 out vec4 vBL;
 
-vec4 fetchF(int texelIndex) {
-    int x = texelIndex % uInstF_W;
-    int y = texelIndex / uInstF_W;
-    return texelFetch(uInstF, ivec2(x, y), 0);
+#if defined(UI_SRGB_TARGET) && !defined(UI_COLOR_F16)
+// exact sRGB curve, matching the framebuffer's encode and UiRenderer's LUT
+vec4 srgbToLinear(vec4 c) {
+    vec3 lo = c.rgb * (1.0 / 12.92);
+    vec3 hi = pow((c.rgb + 0.055) * (1.0 / 1.055), vec3(2.4));
+    return vec4(mix(hi, lo, lessThanEqual(c.rgb, vec3(0.04045))), c.a);
 }
+#endif
 
-uvec4 fetchU(int texelIndex) {
-    int x = texelIndex % uInstU_W;
-    int y = texelIndex / uInstU_W;
-    return texelFetch(uInstU, ivec2(x, y), 0);
+#if defined(UI_COLOR_F16)
+vec4 f16x4(uint rg, uint ba) {
+    return vec4(unpackHalf2x16(rg), unpackHalf2x16(ba));
+}
+#endif
+
+#if defined(UI_INST_TEX)
+#if defined(UI_COLOR_F16)
+#define UI_INST_TEXELS 3
+#else
+#define UI_INST_TEXELS 2
+#endif
+
+uvec4 fetchInst(int texelIndex) {
+    int x = texelIndex % uInst_W;
+    int y = texelIndex / uInst_W;
+    return texelFetch(uInst, ivec2(x, y), 0);
 }
 
-vec4 u8_to_norm(uvec4 p) {
-    return vec4(p) * (1.0 / 255.0);
+// unpackUnorm4x8 is ES 3.10 only
+vec4 u8_to_norm(uint p) {
+    return vec4(uvec4(p, p >> 8, p >> 16, p >> 24) & 0xffu) * (1.0 / 255.0);
 }
+#endif
 
 void main() {
-    // 2 float texels / instance
-    int fBase = gl_InstanceID * 2;
-    vec4 c_half  = fetchF(fBase + 0);   // cx cy hx hy
-    vec4 rad_fea = fetchF(fBase + 1);   // radius feather ...
-
-    // 4 color texels / instance
-    int uBase = gl_InstanceID * 4;
-    vTL = u8_to_norm(fetchU(uBase + 0));
-    vTR = u8_to_norm(fetchU(uBase + 1));
-    vBR = u8_to_norm(fetchU(uBase + 2));
-    vBL = u8_to_norm(fetchU(uBase + 3));
-
-    vec2 center = c_half.xy;
-    vHalf       = c_half.zw;
-
-    vRadius  = rad_fea.x;
-    vFeather = rad_fea.y;
-
-    vLocal = aCorner * vHalf;
-    vec2 pos = center + vLocal;
-
-    gl_Position = uMVP * vec4(pos, 0.0, 1.0);
-}
\ No newline at end of file
+#if defined(UI_INST_TEX)
+    // (cxShape, cyState, hx|hy, radius|stroke), then (tl, tr, br, bl) RGBA8
+    // or two texels of fp16 pairs (UI_COLOR_F16)
+    int inst = (uInstBase + gl_InstanceID) * UI_INST_TEXELS;
+    uvec4 t0 = fetchInst(inst + 0);
+    uvec4 t1 = fetchInst(inst + 1);
+    uvec2 pos = t0.xy;
+    vec4  hrs = vec4(unpackHalf2x16(t0.z), unpackHalf2x16(t0.w));
+#if defined(UI_COLOR_F16)
+    uvec4 t2 = fetchInst(inst + 2);
+    vTL = f16x4(t1.x, t1.y);
+    vTR = f16x4(t1.z, t1.w);
+    vBR = f16x4(t2.x, t2.y);
+    vBL = f16x4(t2.z, t2.w);
+#else
+    vTL = u8_to_norm(t1.x);
+    vTR = u8_to_norm(t1.y);
+    vBR = u8_to_norm(t1.z);
+    vBL = u8_to_norm(t1.w);
+#endif
+#elif defined(UI_INST_ATTR)
+    uvec2 pos = aPos;
+    vec4  hrs = aHalfRad;
+    vTL = aTL;
+    vTR = aTR;
+    vBR = aBR;
+    vBL = aBL;
+#elif defined(UI_INST_SSBO)
+    UiInstGpu inst = uInst[uInstBase + gl_InstanceID];
+    uvec2 pos = inst.pos;
+    vec4  hrs = vec4(unpackHalf2x16(inst.hr.x), unpackHalf2x16(inst.hr.y));
+#if defined(UI_COLOR_F16)
+    vTL = f16x4(inst.colA.x, inst.colA.y);
+    vTR = f16x4(inst.colA.z, inst.colA.w);
+    vBR = f16x4(inst.colB.x, inst.colB.y);
+    vBL = f16x4(inst.colB.z, inst.colB.w);
+#else
+    vTL = unpackUnorm4x8(inst.col.x);
+    vTR = unpackUnorm4x8(inst.col.y);
+    vBR = unpackUnorm4x8(inst.col.z);
+    vBL = unpackUnorm4x8(inst.col.w);
+#endif
+#endif
+
+#if defined(UI_SRGB_TARGET) && !defined(UI_COLOR_F16)
+    vTL = srgbToLinear(vTL);
+    vTR = srgbToLinear(vTR);
+    vBR = srgbToLinear(vBR);
+    vBL = srgbToLinear(vBL);
+#endif
+
+    // low 24 bits: signed 20.4 fixed point; top bytes: shape | feather (1/8 px) << 3, state
+    vec2 center = vec2(ivec2(pos << 8u) >> 8) * (1.0 / 16.0);
+    vShape   = (pos.x >> 24) & 7u;
+    vFeather = float(pos.x >> 27) * (1.0 / 8.0);
+
+    int state = int(pos.y >> 24);
+    int xf    = int(uStateXf[state >> 2][state & 3]);
+    vec4 xfM  = uXform[xf * 2 + 0];
+    vec4 xfT  = uXform[xf * 2 + 1];
+    vClip    = uStateClip[state];
+    vOpacity = xfT.z;
+    vRadius  = hrs.z;
+    vStroke  = hrs.w;
+
+    vec2 world;
+    if (vShape == UI_SHAPE_SEGMENT) {
+        // hrs.xy is the half axis; build the quad in the segment's own frame
+        float len = length(hrs.xy);
+        vec2 dir  = (len > 0.0) ? hrs.xy / len : vec2(1.0, 0.0);
+        vHalf  = vec2(len, 0.5 * vStroke);
+        vLocal = aCorner * vHalf;
+        world  = center + dir * vLocal.x + vec2(-dir.y, dir.x) * vLocal.y;
+    } else {
+        vHalf  = hrs.xy;
+        vLocal = aCorner * vHalf;
+        world  = center + vLocal;
+    }
+
+    // object transform; the clip rect stays in screen space
+    world  = mat2(xfM.xy, xfM.zw) * world + xfT.xy;
+    vWorld = world;
+    gl_Position = uMVP * vec4(world, 0.0, 1.0);
+}
@@ -0,0 +1,411 @@
+// text_bench.cpp - host benchmarks for the text pipeline (TextShaper + utf8 helpers)
+//
+// usage: text_bench FONT [--cjk-font F] [--arabic-font F] [--px N]
+//                        [--min-ms N] [--json FILE] [--font-dir DIR]
+//
+// Reports ns/unit (unit = codepoint for utf8_index, glyph otherwise, box for atlas_alloc),
+// heap allocations and bytes per call, and peak live heap per benchmark.
+// --json writes the same rows machine-readable for regression comparison.
+#include "text_shaper.hpp"
+#include "font_index.hpp"
+#include "utf8.hpp"
+#include "worker_pool.hpp"
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/* ---------------- allocation accounting ----------------
+   glibc-only: interpose malloc & friends so FreeType/HarfBuzz (plain malloc)
+   and operator new (which calls malloc) are all counted. */
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+void  __libc_free(void*);
+}
+
+namespace alloc_stats {
+static std::atomic<uint64_t> g_count{0};
+static std::atomic<uint64_t> g_bytes{0};
+static std::atomic<int64_t>  g_live{0};
+static std::atomic<int64_t>  g_peak{0};
+
+static inline void onAlloc(void* p) {
+    if (!p) return;
+    const int64_t n = (int64_t)malloc_usable_size(p);
+    g_count.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add((uint64_t)n, std::memory_order_relaxed);
+    const int64_t live = g_live.fetch_add(n, std::memory_order_relaxed) + n;
+    int64_t peak = g_peak.load(std::memory_order_relaxed);
+    while (live > peak && !g_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+static inline void onFree(void* p) {
+    if (!p) return;
+    g_live.fetch_sub((int64_t)malloc_usable_size(p), std::memory_order_relaxed);
+}
+
+struct Snapshot {
+    uint64_t count, bytes;
+    int64_t live;
+};
+static Snapshot snapshot() {
+    return Snapshot{g_count.load(), g_bytes.load(), g_live.load()};
+}
+static void resetPeak() { g_peak.store(g_live.load()); }
+static int64_t peak() { return g_peak.load(); }
+} // namespace alloc_stats
+
+extern "C" {
+void* malloc(size_t n) {
+    void* p = __libc_malloc(n);
+    alloc_stats::onAlloc(p);
+    return p;
+}
+void* calloc(size_t n, size_t sz) {
+    void* p = __libc_calloc(n, sz);
+    alloc_stats::onAlloc(p);
+    return p;
+}
+void* realloc(void* old, size_t n) {
+    const size_t oldSize = old ? malloc_usable_size(old) : 0;
+    void* p = __libc_realloc(old, n);
+    if (p || n == 0) alloc_stats::g_live.fetch_sub((int64_t)oldSize, std::memory_order_relaxed);
+    alloc_stats::onAlloc(p);
+    return p;
+}
+void* memalign(size_t align, size_t n) {
+    void* p = __libc_memalign(align, n);
+    alloc_stats::onAlloc(p);
+    return p;
+}
+void* aligned_alloc(size_t align, size_t n) {
+    return memalign(align, n);
+}
+int posix_memalign(void** out, size_t align, size_t n) {
+    void* p = memalign(align, n);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+void free(void* p) {
+    alloc_stats::onFree(p);
+    __libc_free(p);
+}
+}
+
+/* ---------------- corpora ---------------- */
+enum class FontRole { Latin, Cjk, Arabic };
+
+struct Corpus {
+    const char* name;
+    FontRole role;
+    std::vector<const char*> lines;
+};
+
+static std::vector<Corpus> makeCorpora() {
+    return {
+        {"digits", FontRole::Latin, {
+            "0", "1", "2", "3", "4", "5", "6", "7", "8", "9",
+            "1234567890", "3.14159", "2026-10-18", "12:45:07",
+            "+46 70 123 45 67", "1 299,00", "-0.0042", "100%",
+        }},
+        {"english", FontRole::Latin, {
+            "Settings", "Cancel", "OK", "Save changes", "Language",
+            "Wi-Fi and network", "Battery usage in the last 24 hours",
+            "Tap and drag to select text", "Downloading update... 42%",
+            "Are you sure you want to delete this item?",
+            "The quick brown fox jumps over the lazy dog",
+        }},
+        {"cjk", FontRole::Cjk, {
+            "設定", "キャンセル", "保存", "言語を選択してください",
+            "ネットワークとインターネット", "电池使用情况",
+            "下载更新中… 42%", "您确定要删除此项目吗？",
+            "설정", "네트워크 및 인터넷",
+        }},
+        {"arabic", FontRole::Arabic, {
+            "الإعدادات", "إلغاء", "حفظ التغييرات", "اللغة",
+            "الشبكة والإنترنت", "استخدام البطارية خلال آخر 24 ساعة",
+            "هل أنت متأكد أنك تريد حذف هذا العنصر؟",
+        }},
+    };
+}
+
+/* ---------------- runner ---------------- */
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string corpus;
+    std::string bench;
+    const char* unit;
+    uint64_t iters = 0;
+    double nsPerUnit = 0.0;
+    double allocsPerCall = 0.0;
+    double bytesPerCall = 0.0;
+    int64_t peakHeap = 0; // high-water of live heap above the pre-bench baseline
+};
+
+static int64_t g_minNs = 200'000'000; // per benchmark
+
+// `setup` runs untimed (and unaccounted) before every iteration of `fn`.
+// One iteration of `fn` covers `callsPerIter` API calls and `unitsPerIter` units.
+template <class Setup, class Fn>
+static Result run(const char* corpus, const char* bench, const char* unit,
+                  uint64_t callsPerIter, uint64_t unitsPerIter,
+                  Setup&& setup, Fn&& fn) {
+    setup(); fn(); // warm-up
+
+    Result r{corpus, bench, unit};
+    int64_t ns = 0;
+    uint64_t allocs = 0, bytes = 0;
+    const int64_t base = alloc_stats::snapshot().live;
+    alloc_stats::resetPeak();
+    int64_t peak = base;
+
+    while (ns < g_minNs) {
+        setup();
+        const auto s0 = alloc_stats::snapshot();
+        alloc_stats::resetPeak();
+        const auto t0 = Clock::now();
+        fn();
+        const auto t1 = Clock::now();
+        const auto s1 = alloc_stats::snapshot();
+        peak = std::max(peak, alloc_stats::peak());
+
+        ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        allocs += s1.count - s0.count;
+        bytes  += s1.bytes - s0.bytes;
+        r.iters++;
+    }
+
+    const double calls = (double)r.iters * (double)std::max<uint64_t>(callsPerIter, 1);
+    const double units = (double)r.iters * (double)std::max<uint64_t>(unitsPerIter, 1);
+    r.nsPerUnit     = (double)ns / units;
+    r.allocsPerCall = (double)allocs / calls;
+    r.bytesPerCall  = (double)bytes / calls;
+    r.peakHeap      = peak - base;
+    return r;
+}
+
+static bool loadFont(const std::string& path, Assets::Font& out) {
+    // same path as the app: shared read-only mapping, no copy
+    out.mapping = Assets::FontMapping::acquire(path);
+    return !out.empty();
+}
+
+static void benchCorpus(const Corpus& c, TextShaper& ts, std::vector<Result>& out) {
+    // Corpus stats + glyph set
+    uint64_t numCP = 0, numGlyphs = 0;
+    std::vector<uint32_t> gids;
+    for (const char* s : c.lines) {
+        numCP += (uint64_t)utf8::codepointCount(utf8::buildIndex(s));
+        hb_buffer_t* buf = ts.shapeUtf8(s);
+        const unsigned int n = hb_buffer_get_length(buf);
+        const hb_glyph_info_t* infos = hb_buffer_get_glyph_infos(buf, nullptr);
+        for (unsigned int i = 0; i < n; i++) gids.push_back(infos[i].codepoint);
+        numGlyphs += n;
+        hb_buffer_destroy(buf);
+    }
+    std::sort(gids.begin(), gids.end());
+    gids.erase(std::unique(gids.begin(), gids.end()), gids.end());
+
+    const uint64_t lines = c.lines.size();
+    auto nop = [] {};
+
+    // 1) UTF-8 indexing
+    out.push_back(run(c.name, "utf8_index", "cp", lines, numCP, nop, [&] {
+        for (const char* s : c.lines) {
+            auto idx = utf8::buildIndex(s);
+            asm volatile("" : : "r"(idx.data()) : "memory");
+        }
+    }));
+
+    // 2) Shaping
+    out.push_back(run(c.name, "shape", "glyph", lines, numGlyphs, nop, [&] {
+        for (const char* s : c.lines) hb_buffer_destroy(ts.shapeUtf8(s));
+    }));
+
+    // 3) Rasterization of the corpus' unique glyphs into an empty atlas
+    std::vector<std::pair<int, int>> boxes;
+    out.push_back(run(c.name, "raster", "glyph", gids.size(), gids.size(),
+                      [&] { ts.clearGlyphs(); },
+                      [&] {
+        for (uint32_t gid : gids) {
+            TextShaper::GlyphEntry* ge = ts.insertGlyph(gid);
+            if (ge) ts.rasterizeGlyph(*ge, gid);
+        }
+    }));
+    for (uint32_t gid : gids) {
+        const TextShaper::GlyphEntry* ge = ts.findGlyph(gid);
+        if (ge && ge->w > 0 && ge->h > 0) {
+            boxes.emplace_back(ge->w + 2 * TextShaper::kAtlasPad, ge->h + 2 * TextShaper::kAtlasPad);
+        }
+    }
+
+    // 4) Atlas allocation (shelf packer) with the corpus' glyph boxes, repeated
+    constexpr int kAllocRepeat = 16;
+    out.push_back(run(c.name, "atlas_alloc", "box", boxes.size() * kAllocRepeat, boxes.size() * kAllocRepeat,
+                      [&] { ts.clearGlyphs(); },
+                      [&] {
+        int x, y;
+        for (int r = 0; r < kAllocRepeat; r++) {
+            for (const auto& [w, h] : boxes) ts.atlasAlloc(w, h, x, y);
+        }
+    }));
+
+    // 5) buildMesh, cold (includes rasterization) and warm (glyph cache hit)
+    std::vector<TextLayout> layouts(c.lines.size());
+    const RGBA white{255, 255, 255, 255};
+    auto buildAll = [&] {
+        for (size_t i = 0; i < c.lines.size(); i++) ts.buildMesh(c.lines[i], white, layouts[i]);
+    };
+    out.push_back(run(c.name, "build_mesh_cold", "glyph", lines, numGlyphs,
+                      [&] { ts.clearGlyphs(); }, buildAll));
+    out.push_back(run(c.name, "build_mesh_warm", "glyph", lines, numGlyphs, nop, buildAll));
+
+    // 6) buildMeshes: the whole corpus as one batch across WorkerPool::shared()
+    std::vector<MeshJob> jobs(c.lines.size());
+    auto batchAll = [&] {
+        for (size_t i = 0; i < c.lines.size(); i++) jobs[i] = MeshJob{c.lines[i], white, &layouts[i]};
+        ts.buildMeshes(jobs);
+    };
+    out.push_back(run(c.name, "build_meshes_cold", "glyph", lines, numGlyphs,
+                      [&] { ts.clearGlyphs(); }, batchAll));
+    out.push_back(run(c.name, "build_meshes_warm", "glyph", lines, numGlyphs, nop, batchAll));
+}
+
+// FontIndex over a stand-in font directory (e.g. /usr/share/fonts): a full
+// enumerate, a fingerprint + cached read, and file-name lookups.
+static void benchFontIndex(const std::string& dir, std::vector<Result>& out) {
+    const Assets::DirFontSource src(dir);
+    const std::string cache = "/tmp/text_bench_fonts.idx";
+    std::remove(cache.c_str());
+
+    Assets::FontIndex idx;
+    idx.load(src, cache);
+    const uint64_t faces = idx.size();
+    if (!faces) {
+        std::fprintf(stderr, "no fonts under %s\n", dir.c_str());
+        return;
+    }
+    std::vector<std::string> names;
+    src.enumerate([&](Assets::FontFace&& f) { names.push_back(f.path.substr(f.path.find_last_of('/') + 1)); });
+
+    auto nop = [] {};
+    out.push_back(run("fonts", "index_build", "face", 1, faces, nop, [&] {
+        Assets::FontIndex i;
+        i.build(src);
+    }));
+    out.push_back(run("fonts", "index_cached", "face", 1, faces, nop, [&] {
+        Assets::FontIndex i;
+        i.load(src, cache);
+    }));
+    size_t hits = 0;
+    out.push_back(run("fonts", "index_find", "call", names.size(), names.size(), nop, [&] {
+        for (const auto& n : names) hits += idx.find(n) != nullptr;
+    }));
+    std::remove(cache.c_str());
+}
+
+static void printTable(const std::vector<Result>& rs) {
+    std::printf("%-8s %-16s %10s %-5s %12s %12s %12s %8s\n",
+                "corpus", "bench", "ns/unit", "unit", "allocs/call", "bytes/call", "peak_heap", "iters");
+    for (const auto& r : rs) {
+        std::printf("%-8s %-16s %10.1f %-5s %12.2f %12.1f %12lld %8llu\n",
+                    r.corpus.c_str(), r.bench.c_str(), r.nsPerUnit, r.unit,
+                    r.allocsPerCall, r.bytesPerCall,
+                    (long long)r.peakHeap, (unsigned long long)r.iters);
+    }
+}
+
+static bool writeJson(const std::string& path, const std::vector<Result>& rs,
+                      const std::string& font, int px, long maxRssKb) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "{\n  \"font\": \"%s\",\n  \"px\": %d,\n  \"workers\": %u,\n  \"max_rss_kb\": %ld,\n  \"results\": [\n",
+                 font.c_str(), px, WorkerPool::shared().workerCount(), maxRssKb);
+    for (size_t i = 0; i < rs.size(); i++) {
+        const auto& r = rs[i];
+        std::fprintf(f,
+            "    {\"corpus\": \"%s\", \"bench\": \"%s\", \"unit\": \"%s\", \"ns_per_unit\": %.3f, "
+            "\"allocs_per_call\": %.3f, \"bytes_per_call\": %.1f, \"peak_heap_bytes\": %lld, \"iters\": %llu}%s\n",
+            r.corpus.c_str(), r.bench.c_str(), r.unit, r.nsPerUnit,
+            r.allocsPerCall, r.bytesPerCall, (long long)r.peakHeap,
+            (unsigned long long)r.iters, (i + 1 < rs.size()) ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+    std::fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string fontPath, cjkPath, arabicPath, jsonPath, fontDir;
+    int px = 48;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        auto next = [&]() -> const char* { return (i + 1 < argc) ? argv[++i] : ""; };
+        if      (a == "--cjk-font")    cjkPath = next();
+        else if (a == "--arabic-font") arabicPath = next();
+        else if (a == "--px")          px = std::atoi(next());
+        else if (a == "--min-ms")      g_minNs = (int64_t)std::atoll(next()) * 1'000'000;
+        else if (a == "--json")        jsonPath = next();
+        else if (a == "--font-dir")    fontDir = next();
+        else if (fontPath.empty())     fontPath = a;
+    }
+    if (fontPath.empty()) {
+        std::fprintf(stderr, "usage: %s FONT [--cjk-font F] [--arabic-font F] [--px N] [--min-ms N] [--json FILE] [--font-dir DIR]\n", argv[0]);
+        return 2;
+    }
+    if (cjkPath.empty())    cjkPath = fontPath;
+    if (arabicPath.empty()) arabicPath = fontPath;
+
+    auto makeShaper = [&](const std::string& path) -> std::unique_ptr<TextShaper> {
+        Assets::Font font;
+        if (!loadFont(path, font)) {
+            std::fprintf(stderr, "failed to read font: %s\n", path.c_str());
+            return nullptr;
+        }
+        auto ts = std::make_unique<TextShaper>();
+        if (!ts->init(std::move(font), px, 2048, 2048)) {
+            std::fprintf(stderr, "TextShaper::init failed: %s\n", path.c_str());
+            return nullptr;
+        }
+        return ts;
+    };
+    auto latin  = makeShaper(fontPath);
+    auto cjk    = (cjkPath == fontPath) ? nullptr : makeShaper(cjkPath);
+    auto arabic = (arabicPath == fontPath) ? nullptr : makeShaper(arabicPath);
+    if (!latin) return 1;
+
+    std::vector<Result> results;
+    for (const Corpus& c : makeCorpora()) {
+        TextShaper* ts = latin.get();
+        if (c.role == FontRole::Cjk && cjk) ts = cjk.get();
+        if (c.role == FontRole::Arabic && arabic) ts = arabic.get();
+        benchCorpus(c, *ts, results);
+    }
+    if (!fontDir.empty()) benchFontIndex(fontDir, results);
+
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+
+    printTable(results);
+    std::printf("workers=%u max_rss_kb=%ld\n", WorkerPool::shared().workerCount(), ru.ru_maxrss);
+
+    if (!jsonPath.empty() && !writeJson(jsonPath, results, fontPath, px, ru.ru_maxrss)) {
+        std::fprintf(stderr, "failed to write %s\n", jsonPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+// asset_bundle.cpp
+#include "asset_bundle.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "logging.hpp"
+static constexpr char NS[] = "Bundle";
+using logx = logger::logx<NS>;
+
+namespace Assets {
+
+static uint64_t alignUp(uint64_t v) {
+    return (v + kBundleAlign - 1) & ~(uint64_t)(kBundleAlign - 1);
+}
+
+/* ---------------- reader ---------------- */
+BundleAssetSource::BundleAssetSource(AssetView whole) : m_whole(std::move(whole)) {
+    const char* base = m_whole.data();
+    const size_t size = m_whole.size();
+    if (size < sizeof(BundleHeader)) return;
+
+    BundleHeader h;
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, kBundleMagic, sizeof(h.magic)) != 0 || h.version != kBundleVersion) {
+        logx::E("not a bundle (magic/version)");
+        return;
+    }
+    const uint64_t indexEnd = sizeof(BundleHeader) + (uint64_t)h.count * sizeof(BundleEntry);
+    if (h.fileSize != size || indexEnd > h.namesOffset || h.namesOffset > size) {
+        logx::Ef("truncated or corrupt bundle ({} bytes, header says {})", size, h.fileSize);
+        return;
+    }
+    m_index = base + sizeof(BundleHeader);
+    const uint64_t namesSize = size - h.namesOffset;
+    for (uint32_t i = 0; i < h.count; i++) {
+        const BundleEntry e = entry(i);
+        if (e.offset % kBundleAlign || e.offset > size || e.size > size - e.offset ||
+            (uint64_t)e.nameOffset + e.nameLength > namesSize) {
+            logx::Ef("bad entry {}", i);
+            m_index = nullptr;
+            return;
+        }
+    }
+    m_names = base + h.namesOffset;
+    m_count = h.count;
+}
+
+BundleEntry BundleAssetSource::entry(size_t i) const {
+    BundleEntry e;
+    std::memcpy(&e, m_index + i * sizeof(BundleEntry), sizeof(e));
+    return e;
+}
+
+std::string_view BundleAssetSource::nameOf(const BundleEntry& e) const {
+    return {m_names + e.nameOffset, e.nameLength};
+}
+
+bool BundleAssetSource::find(std::string_view name, BundleEntry& out) const {
+    if (!m_index) return false;
+    size_t lo = 0, hi = m_count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const BundleEntry e = entry(mid);
+        const int c = nameOf(e).compare(name);
+        if (c == 0) { out = e; return true; }
+        if (c < 0) lo = mid + 1; else hi = mid;
+    }
+    return false;
+}
+
+AssetView BundleAssetSource::open(const std::string& name) const {
+    BundleEntry e;
+    if (!find(name, e) || !e.size) return {};
+    // every entry keeps the whole bundle alive
+    return m_whole.slice((size_t)e.offset, (size_t)e.size);
+}
+
+/* ---------------- writer ---------------- */
+void BundleWriter::add(std::string name, std::vector<uint8_t> data, BundleKind kind) {
+    for (Item& it : m_items) {
+        if (it.name == name) { it.data = std::move(data); it.kind = kind; return; }
+    }
+    m_items.push_back({std::move(name), std::move(data), kind});
+}
+bool BundleWriter::has(std::string_view name) const {
+    return std::any_of(m_items.begin(), m_items.end(), [&](const Item& it) { return it.name == name; });
+}
+
+bool BundleWriter::write(const std::string& path) const {
+    std::vector<const Item*> items;
+    for (const Item& it : m_items) items.push_back(&it);
+    std::sort(items.begin(), items.end(), [](const Item* a, const Item* b) { return a->name < b->name; });
+
+    std::vector<BundleEntry> index(items.size());
+    std::string names;
+    for (size_t i = 0; i < items.size(); i++) {
+        index[i].nameOffset = (uint32_t)names.size();
+        index[i].nameLength = (uint32_t)items[i]->name.size();
+        index[i].kind = items[i]->kind;
+        names += items[i]->name;
+    }
+    BundleHeader h{};
+    std::memcpy(h.magic, kBundleMagic, sizeof(h.magic));
+    h.version = kBundleVersion;
+    h.count = (uint32_t)items.size();
+    h.namesOffset = sizeof(BundleHeader) + index.size() * sizeof(BundleEntry);
+    uint64_t off = alignUp(h.namesOffset + names.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        index[i].offset = off;
+        index[i].size = items[i]->data.size();
+        off = alignUp(off + index[i].size);
+    }
+    // the last payload isn't padded
+    h.fileSize = items.empty() ? h.namesOffset + names.size() : index.back().offset + index.back().size;
+
+    // write-then-rename, like the other persisted files
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(index.data()), (std::streamsize)(index.size() * sizeof(BundleEntry)));
+        out.write(names.data(), (std::streamsize)names.size());
+        uint64_t pos = h.namesOffset + names.size();
+        static constexpr char kZeros[kBundleAlign] = {};
+        for (size_t i = 0; i < items.size(); i++) {
+            out.write(kZeros, (std::streamsize)(index[i].offset - pos));
+            out.write(reinterpret_cast<const char*>(items[i]->data.data()), (std::streamsize)index[i].size);
+            pos = index[i].offset + index[i].size;
+        }
+        if (!out) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+}
@@ -0,0 +1,95 @@
+// asset_bundle.hpp - one packed, mmappable file holding every asset by name
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "asset_view.hpp"
+
+namespace Assets {
+
+/*Layout (little-endian, every offset from the start of the file):
+
+    BundleHeader
+    BundleEntry[count]     sorted by name, for binary search
+    names                  concatenated, not NUL-terminated
+    payloads               each at a multiple of kBundleAlign
+
+The whole file is mapped once (or viewed in place in the APK, which must
+store it uncompressed); entries are served as views into that mapping.
+Alignment is relative to the file: an APK only guarantees 4 bytes for the
+file itself, so the reader never dereferences the index in place.*/
+inline constexpr char     kBundleMagic[8] = {'E', 'G', 'L', 'B', 'N', 'D', 'L', '1'};
+inline constexpr uint32_t kBundleVersion = 1;
+// cache line; also satisfies every POD payload read in place
+inline constexpr uint32_t kBundleAlign = 64;
+
+// What a payload is. Baked ones are produced by the tool from other entries.
+enum class BundleKind : uint32_t {
+    File = 0,       // a source file as is (shaders, fonts)
+    GlyphAtlas = 1, // TextShaper::saveAtlas() output: glyph metrics + A8 pixels
+};
+
+struct BundleHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t namesOffset;
+    uint64_t fileSize;
+};
+struct BundleEntry {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t nameOffset; // into names
+    uint32_t nameLength;
+    BundleKind kind;
+    uint32_t reserved;
+};
+static_assert(sizeof(BundleHeader) == 32 && sizeof(BundleEntry) == 32);
+
+// Asset name of the bundle itself, and of a font's baked glyph atlas
+inline constexpr char kBundleName[] = "assets.bundle";
+inline std::string atlasName(std::string_view font, int pixelSize) {
+    return "atlas/" + std::string(font) + "@" + std::to_string(pixelSize);
+}
+
+// Serves a bundle held by any view (a DirAssetSource mapping, an APK asset).
+class BundleAssetSource : public AssetSource {
+public:
+    // Checks the header and index; valid() is false if anything is off.
+    explicit BundleAssetSource(AssetView whole);
+    bool valid() const { return m_index != nullptr; }
+    size_t count() const { return m_count; }
+
+    AssetView open(const std::string& name) const override;
+    bool find(std::string_view name, BundleEntry& out) const;
+    BundleEntry entry(size_t i) const;
+    std::string_view nameOf(const BundleEntry& e) const;
+
+private:
+    AssetView m_whole;
+    const char* m_index = nullptr;
+    const char* m_names = nullptr;
+    size_t m_count = 0;
+};
+
+// Used by the host tool; the app only reads bundles.
+class BundleWriter {
+public:
+    void add(std::string name, std::vector<uint8_t> data, BundleKind kind = BundleKind::File);
+    bool has(std::string_view name) const;
+    bool write(const std::string& path) const;
+
+private:
+    struct Item {
+        std::string name;
+        std::vector<uint8_t> data;
+        BundleKind kind;
+    };
+    std::vector<Item> m_items;
+};
+
+}
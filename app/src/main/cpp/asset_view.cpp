@@ -0,0 +1,55 @@
+// asset_view.cpp
+#include "asset_view.hpp"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.hpp"
+static constexpr char NS[] = "AssetView";
+using logx = logger::logx<NS>;
+
+namespace Assets {
+
+AssetView DirAssetSource::open(const std::string& name) const {
+    const std::string path = m_root + "/" + name;
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return {};
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) { close(fd); return {}; }
+    const size_t size = (size_t)st.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        logx::Ef("open: mmap failed: {} (errno={})", path, errno);
+        return {};
+    }
+    std::shared_ptr<const void> owner(addr, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+    return AssetView(static_cast<const char*>(addr), size, std::move(owner));
+}
+
+#ifdef __ANDROID__
+AssetView ApkAssetSource::open(const std::string& name) const {
+    if (!m_am) return {};
+    AAsset* a = AAssetManager_open(m_am, name.c_str(), AASSET_MODE_BUFFER);
+    if (!a) return {};
+
+    const void* buf = AAsset_getBuffer(a);
+    const size_t size = (size_t)AAsset_getLength64(a);
+    if (!buf || !size) {
+        logx::Ef("open: no buffer for {}", name);
+        AAsset_close(a);
+        return {};
+    }
+    if (AAsset_isAllocated(a)) logx::If("open: {} is compressed, inflated {} bytes", name, size);
+
+    std::shared_ptr<const void> owner(a, [](const void* p) { AAsset_close(static_cast<AAsset*>(const_cast<void*>(p))); });
+    return AssetView(static_cast<const char*>(buf), size, std::move(owner));
+}
+#endif
+
+}
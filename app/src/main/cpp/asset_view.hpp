@@ -0,0 +1,66 @@
+// asset_view.hpp - zero-copy read-only views of packaged assets
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef __ANDROID__
+#include <android/asset_manager.h>
+#endif
+
+namespace Assets {
+
+// Read-only bytes of one asset, valid as long as any copy of the view is
+// alive (the owner releases the mapping/asset). Not NUL-terminated.
+class AssetView {
+public:
+    AssetView() = default;
+    AssetView(const char* data, size_t size, std::shared_ptr<const void> owner)
+        : m_data(data), m_size(size), m_owner(std::move(owner)) {}
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    std::string_view str() const { return {m_data, m_size}; }
+    // [offset, offset + size) of this view, keeping the same owner alive
+    AssetView slice(size_t offset, size_t size) const { return AssetView(m_data + offset, size, m_owner); }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+    std::shared_ptr<const void> m_owner;
+};
+
+class AssetSource {
+public:
+    virtual ~AssetSource() = default;
+    // empty view if the asset doesn't exist or can't be read
+    virtual AssetView open(const std::string& name) const = 0;
+};
+
+// Files under root, mmapped read-only (host builds, tools).
+class DirAssetSource : public AssetSource {
+public:
+    explicit DirAssetSource(std::string root) : m_root(std::move(root)) {}
+    AssetView open(const std::string& name) const override;
+private:
+    std::string m_root;
+};
+
+#ifdef __ANDROID__
+// APK assets. Stored (uncompressed) entries are viewed in place in the mapped
+// APK; compressed ones are inflated once into the AAsset's own buffer, which
+// lives as long as the view. Nothing is written to storage.
+class ApkAssetSource : public AssetSource {
+public:
+    explicit ApkAssetSource(AAssetManager* am) : m_am(am) {}
+    AssetView open(const std::string& name) const override;
+private:
+    AAssetManager* m_am = nullptr;
+};
+#endif
+
+}
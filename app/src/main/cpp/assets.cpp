@@ -1,67 +1,60 @@
 #include "assets.hpp"
 
-#include <fstream>
-#include <cerrno>
+#include <chrono>
 #include <cstddef>
 
-#include <android/system_fonts.h>
-#include <fcntl.h>
-
 #include "logging.hpp"
 static constexpr char NS[] = "Assets";
 using logx = logger::logx<NS>;
 
 namespace Assets {
 
-static std::vector<char> read_bytes(std::ifstream& f) {
-    std::vector<char> b{};
-    f.seekg(0, std::ios::end);
-    size_t fsize = f.tellg();
-    f.seekg(0);
-    if (!fsize) return {};
-    b.resize(fsize);
-    f.read(b.data(), b.size());
-    return b;
-}
-static std::vector<char> read_bytes(const std::string& path) {
-    std::ifstream f(path, std::ios::binary);
-    return read_bytes(f);
+const FontIndex& Manager::font_index() const {
+    std::lock_guard<std::mutex> lk(m_font_mx);
+    if (!m_font_index) {
+        const auto t0 = std::chrono::steady_clock::now();
+        m_font_index = std::make_unique<FontIndex>();
+        m_font_index->load(SystemFontSource{}, m_data_path.empty() ? std::string{} : m_data_path + "/fonts.idx");
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        logx::If("font_index: {} faces ({}) in {:.2f} ms", m_font_index->size(),
+                 m_font_index->fromCache() ? "cached" : "built", ms);
+    }
+    return *m_font_index;
 }
-
 Font Manager::get_font(const std::string& name) const {
     Font f{};
-    logx::If("get_font: target name={}", name);
-    
-    ASystemFontIterator* it = ASystemFontIterator_open();
-
-    while (AFont* font = ASystemFontIterator_next(it)) {
-        std::string path{AFont_getFontFilePath(font)};
-        logx::If("get_font: iter...: {}", path);
-        if (path.find(name) != std::string::npos) {
-            //fi.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
-            logx::If("get_font: found match: {}", path);
-            f.bytes = read_bytes(path);
-            f.collectionIndex = AFont_getCollectionIndex(font);
-
-            for (size_t i = 0; i < AFont_getAxisCount(font); ++i) {
-                f.variationSettings.emplace_back(
-                    AFont_getAxisTag(font, i),
-                    AFont_getAxisValue(font, i));
-            }
-
-            AFont_close(font);
-            break;
+    if (m_bundle) {
+        f.view = m_bundle->open("fonts/" + name);
+        if (!f.view.empty()) {
+            logx::If("get_font: {} -> bundle", name);
+            return f;
         }
-        AFont_close(font);
     }
+    const FontFace* face = font_index().find(name);
+    if (!face) {
+        logx::Ef("get_font: no match for {}", name);
+        return f;
+    }
+    logx::If("get_font: {} -> {} #{}", name, face->path, face->collectionIndex);
 
-    ASystemFontIterator_close(it);
+    // open + mmap, shared with every other Font of this file/face (see FontMapping)
+    f.collectionIndex = face->collectionIndex;
+    f.variationSettings = face->axes;
+    f.mapping = FontMapping::acquire(face->path, f.collectionIndex);
     return f;
 }
 
 Manager::Manager(android_app* app) {
     if (app && app->activity) {
-        m_am = app->activity->assetManager;
+        m_assets = std::make_unique<ApkAssetSource>(app->activity->assetManager);
+        // one view of the whole bundle; every asset in it is a slice of that
+        if (AssetView whole = m_assets->open(kBundleName); !whole.empty()) {
+            auto bundle = std::make_unique<BundleAssetSource>(std::move(whole));
+            if (bundle->valid()) {
+                logx::If("{}: {} entries", kBundleName, bundle->count());
+                m_bundle = std::move(bundle);
+            }
+        }
         if (app->activity->internalDataPath) {
             m_data_path = app->activity->internalDataPath;
         }
@@ -71,75 +64,23 @@ Manager::Manager(android_app* app) {
     }
 }
 
-std::string Manager::normalize_path(const std::string& asset_name) const {
-    if (m_data_path.empty() || !m_am) return {};
-
-    auto const base_beg = asset_name.find_last_of('/');
-    const char* base = asset_name.c_str() + ((base_beg != std::string::npos) ? base_beg + 1 : 0);
-    std::string out = m_data_path + "/" + base;
-    return out;
+AssetView Manager::view(const std::string& asset_name) const {
+    // the APK carries no loose copy of what the bundle packs (build.gradle.kts)
+    AssetView v = baked(asset_name);
+    if (v.empty() && m_assets) v = m_assets->open(asset_name);
+    if (v.empty()) logx::Ef("view: not found: {}", asset_name);
+    return v;
 }
-
-std::string Manager::ensureAvailable(const std::string& asset_name) const {
-    std::string out = normalize_path(asset_name);
-    if (out.empty()) return {};
-    
-    logx::If("ensureAvailable: target path={}", out);
-    {
-        std::ifstream ftest(out, std::ios::binary);
-        if (ftest.is_open()) { return out; }
-    }
-
-    logx::If("ensureAvailable: opening {}", asset_name);
-    AAsset* a = AAssetManager_open(m_am, asset_name.c_str(), AASSET_MODE_STREAMING);
-    if (!a) {
-        logx::Ef("ensureAvailable: not found: {}", asset_name);
-        return {};
-    }
-
-    std::ofstream f(out, std::ios::binary);
-    if (!f.is_open()) {
-        logx::Ef("ensureAvailable: fopen(wb) failed: {} (errno={})", out, errno);
-        AAsset_close(a);
-        return {};
-    }
-
-    char buf[16 * 1024];
-    int r;
-    size_t total = 0;
-    while ((r = AAsset_read(a, buf, (int)sizeof(buf))) > 0) {
-        size_t rsize = static_cast<size_t>(r);
-        f.write(buf, rsize);
-        if (!f) {
-            logx::Ef("ensureAvailable: write failed (bad={} fail={})", (int)f.bad(), (int)f.fail());
-            f.close();
-            AAsset_close(a);
-            return {};
-        }
-        total += rsize;
-    }
-    if (r < 0) {
-        logx::E("ensureAvailable: AAsset_read failed");
-        f.close();
-        AAsset_close(a);
-        return {};
-    }
-
-    f.close();
-    AAsset_close(a);
-    logx::If("ensureAvailable: copied {} -> {} ({} bytes)", asset_name, out, total);
-    return out;
+AssetView Manager::baked(const std::string& asset_name) const {
+    return m_bundle ? m_bundle->open(asset_name) : AssetView{};
 }
 std::vector<char> Manager::read(const std::string& asset_name) const {
-    std::string path = ensureAvailable(asset_name);
-    if (path.empty()) return {};
-    
-    std::ifstream f(path, std::ios::binary | std::ios::ate);
-    if (!f.is_open()) return {};
-    
-    std::vector<char> out = read_bytes(f);
-    if (out.empty()) return {};
-    
+    AssetView v = view(asset_name);
+    if (v.empty()) return {};
+
+    std::vector<char> out;
+    out.reserve(v.size() + 1);
+    out.assign(v.data(), v.data() + v.size());
     out.push_back('\0');
     return out;
 }
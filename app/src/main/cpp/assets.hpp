@@ -2,36 +2,43 @@
 
 #include <android_native_app_glue.h>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <utility>
 
 #include <unistd.h>
 
-namespace Assets {
+#include "asset_bundle.hpp"
+#include "asset_view.hpp"
+#include "font.hpp"
+#include "font_index.hpp"
 
-struct Font {
-    std::vector<char> bytes{};
-    int collectionIndex{0};
-    std::vector<std::pair<uint32_t, float>> variationSettings{};
-    
-    Font() = default;
-    Font(const Font&) = delete;
-    Font& operator=(const Font&) = delete;
-    Font(Font&&) noexcept = default;
-    Font& operator=(Font&&) noexcept = default;
-};
+namespace Assets {
 
 class Manager {
   public:
     Manager(android_app* app);
-    std::string ensureAvailable(const std::string& asset_name) const;
+    // zero-copy; empty if missing. The bundle first, then loose files.
+    AssetView view(const std::string& asset_name) const;
+    // a precompiled payload from the bundle; empty, without logging, if absent
+    AssetView baked(const std::string& asset_name) const;
+    // owned, NUL-terminated copy of view()
     std::vector<char> read(const std::string& asset_name) const;
+    // name: file name, "Family-Style" or family (see FontIndex::find);
+    // "fonts/<name>" in the bundle wins over the system fonts
     Font get_font(const std::string& name) const;
+    // built (or read from internalDataPath) on first use
+    const FontIndex& font_index() const;
+    // internalDataPath; empty if the activity has none
+    const std::string& data_path() const { return m_data_path; }
   private:
-    std::string normalize_path(const std::string& asset_name) const;
-    AAssetManager* m_am{nullptr};
+    std::unique_ptr<AssetSource> m_assets{};
+    std::unique_ptr<BundleAssetSource> m_bundle{};
     std::string m_data_path{};
+    mutable std::mutex m_font_mx{};
+    mutable std::unique_ptr<FontIndex> m_font_index{};
 };
 
 }
\ No newline at end of file
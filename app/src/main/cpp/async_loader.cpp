@@ -0,0 +1,47 @@
+// async_loader.cpp
+#include "async_loader.hpp"
+
+AsyncLoader::AsyncLoader(unsigned threads) {
+    m_threads.reserve(threads);
+    for (unsigned i = 0; i < threads; i++) {
+        m_threads.emplace_back([this] { workerMain(); });
+    }
+}
+AsyncLoader::~AsyncLoader() {
+    {
+        std::lock_guard<std::mutex> lk(m_mx);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& t : m_threads) t.join();
+}
+
+void AsyncLoader::push(std::function<void()> job) {
+    if (m_threads.empty()) { job(); return; }
+    {
+        std::lock_guard<std::mutex> lk(m_mx);
+        m_jobs.push_back(std::move(job));
+    }
+    m_cv.notify_one();
+}
+void AsyncLoader::workerMain() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lk(m_mx);
+            m_cv.wait(lk, [&] { return m_stop || !m_jobs.empty(); });
+            // drain the queue before stopping
+            if (m_jobs.empty()) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+
+std::future<Assets::AssetView> AsyncLoader::readAsset(const Assets::Manager& am, std::string name) {
+    return submit([&am, name = std::move(name)] { return am.view(name); });
+}
+std::future<Assets::Font> AsyncLoader::loadFont(const Assets::Manager& am, std::string name) {
+    return submit([&am, name = std::move(name)] { return am.get_font(name); });
+}
@@ -0,0 +1,60 @@
+// async_loader.hpp - small job queue returning futures, for loading off the render thread
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "assets.hpp"
+
+// Unlike WorkerPool (fork/join, caller blocks), jobs here run in the background
+// and hand results back as std::futures the render thread polls. Jobs must not
+// touch GL; the render thread creates GL objects once their futures are ready.
+class AsyncLoader {
+public:
+    explicit AsyncLoader(unsigned threads = 2);
+    // Finishes queued jobs first, so nothing outlives what they reference.
+    ~AsyncLoader();
+
+    AsyncLoader(const AsyncLoader&) = delete;
+    AsyncLoader& operator=(const AsyncLoader&) = delete;
+
+    template <class F>
+    auto submit(F&& fn) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        // std::function needs a copyable target; packaged_task isn't
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+        std::future<R> f = task->get_future();
+        push([task] { (*task)(); });
+        return f;
+    }
+
+    // Common jobs
+    std::future<Assets::AssetView> readAsset(const Assets::Manager& am, std::string name);
+    std::future<Assets::Font> loadFont(const Assets::Manager& am, std::string name);
+
+    // futures are ready when f.wait_for(0) says so; this never blocks
+    template <class T>
+    static bool ready(const std::future<T>& f) {
+        return f.valid() && f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+private:
+    void push(std::function<void()> job);
+    void workerMain();
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mx;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_stop = false;
+};
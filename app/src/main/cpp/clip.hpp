@@ -0,0 +1,35 @@
+// clip.hpp - axis-aligned clip rects (screen space) for UiRenderer / TextRenderer
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+struct ClipRect {
+    float x0, y0, x1, y1;
+
+    // "no clip": large enough to contain anything, small enough to stay exact in fp32
+    static constexpr ClipRect none() { return { -1e30f, -1e30f, 1e30f, 1e30f }; }
+    static constexpr ClipRect fromXYWH(float x, float y, float w, float h) { return { x, y, x + w, y + h }; }
+
+    ClipRect intersect(const ClipRect& o) const {
+        return { std::max(x0, o.x0), std::max(y0, o.y0), std::min(x1, o.x1), std::min(y1, o.y1) };
+    }
+    bool overlaps(float bx0, float by0, float bx1, float by1) const {
+        return bx1 > x0 && bx0 < x1 && by1 > y0 && by0 < y1;
+    }
+    bool operator==(const ClipRect&) const = default;
+};
+
+// push() intersects with the current top, so nested panels clip to their parents.
+class ClipStack {
+public:
+    void push(const ClipRect& r) { m_stack.push_back(m_stack.empty() ? r : r.intersect(m_stack.back())); }
+    void pop() { if (!m_stack.empty()) m_stack.pop_back(); }
+    void clear() { m_stack.clear(); }
+    bool active() const { return !m_stack.empty(); }
+    ClipRect top() const { return m_stack.empty() ? ClipRect::none() : m_stack.back(); }
+    const std::vector<ClipRect>& entries() const { return m_stack; }
+
+private:
+    std::vector<ClipRect> m_stack;
+};
@@ -0,0 +1,49 @@
+// damage.hpp - screen-space region that changed since the last presented frame
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "clip.hpp"
+
+// Renderers add the old and new bounds of whatever they changed; the frame loop
+// repaints (and swaps) only that region. One union rect: UI edits are usually
+// local, and a single scissor + damage rect keeps the GL side trivial. Empty
+// means nothing needs to be drawn at all.
+class Damage {
+public:
+    void add(float x0, float y0, float x1, float y1) {
+        if (!(x1 > x0 && y1 > y0)) return;
+        if (empty()) { m_r = {x0, y0, x1, y1}; return; }
+        m_r = {std::min(m_r.x0, x0), std::min(m_r.y0, y0), std::max(m_r.x1, x1), std::max(m_r.y1, y1)};
+    }
+    void add(const ClipRect& r) { add(r.x0, r.y0, r.x1, r.y1); }
+    void add(const Damage& d) {
+        if (d.m_full) setFull();
+        else if (!d.empty()) add(d.m_r);
+    }
+    void setFull() { m_full = true; }
+    void clear() { m_r = kEmpty; m_full = false; }
+
+    bool full() const { return m_full; }
+    bool empty() const { return !m_full && !(m_r.x1 > m_r.x0 && m_r.y1 > m_r.y0); }
+    // Whole pixels covering the region, clamped to a w x h target (top-left origin).
+    // full() covers the target.
+    bool pixels(int w, int h, int& x, int& y, int& rw, int& rh) const {
+        if (empty()) return false;
+        int x0 = 0, y0 = 0, x1 = w, y1 = h;
+        if (!m_full) {
+            x0 = std::max(0, (int)std::floor(m_r.x0)); y0 = std::max(0, (int)std::floor(m_r.y0));
+            x1 = std::min(w, (int)std::ceil(m_r.x1));  y1 = std::min(h, (int)std::ceil(m_r.y1));
+        }
+        if (x1 <= x0 || y1 <= y0) return false;
+        x = x0; y = y0; rw = x1 - x0; rh = y1 - y0;
+        return true;
+    }
+    const ClipRect& bounds() const { return m_r; }
+
+private:
+    static constexpr ClipRect kEmpty{0.0f, 0.0f, 0.0f, 0.0f};
+    ClipRect m_r = kEmpty;
+    bool m_full = false;
+};
@@ -0,0 +1,64 @@
+// draw_list.cpp
+#include "draw_list.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void GpuState::useProgram(GLuint prog) {
+    if (prog == m_prog) return;
+    glUseProgram(prog);
+    m_prog = prog;
+    m_counts.program++;
+}
+void GpuState::bindTexture(GLuint tex) {
+    if (tex == m_tex) return;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    m_tex = tex;
+    m_counts.texture++;
+}
+void GpuState::blend(BlendMode mode) {
+    if (m_blendKnown && mode == m_blend) return;
+    switch (mode) {
+        case BlendMode::Premultiplied: glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); break;
+        case BlendMode::Straight:      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); break;
+    }
+    m_blend = mode;
+    m_blendKnown = true;
+    m_counts.blend++;
+}
+
+uint64_t DrawList::makeKey(uint8_t layer, uint16_t depth, GLuint program, GLuint texture, BlendMode blend) {
+    // GL names only group equal state here, so their low 16 bits are enough
+    return ((uint64_t)layer << 56) |
+           ((uint64_t)depth << 40) |
+           ((uint64_t)(program & 0xffffu) << 24) |
+           ((uint64_t)(texture & 0xffffu) << 8) |
+           (uint64_t)blend;
+}
+void DrawList::begin(const float* mvp4x4) {
+    m_cmds.clear();
+    std::memcpy(m_mvp, mvp4x4, sizeof(m_mvp));
+}
+void DrawList::submit(uint8_t layer, uint16_t depth, GLuint program, GLuint texture, BlendMode blend,
+                      Fn fn, void* ctx, uint32_t a, uint32_t b, uint32_t c) {
+    m_cmds.push_back({ makeKey(layer, depth, program, texture, blend), fn, ctx, a, b, c, blend });
+}
+void DrawList::flush() {
+    // stable: equal keys keep submission order
+    std::stable_sort(m_cmds.begin(), m_cmds.end(),
+                     [](const Cmd& x, const Cmd& y) { return x.key < y.key; });
+
+    // anything may have been bound since the last frame
+    m_state.reset();
+    m_state.resetCounts();
+    for (const Cmd& cmd : m_cmds) {
+        m_state.blend(cmd.blend);
+        cmd.fn(cmd.ctx, cmd.a, cmd.b, cmd.c, *this);
+    }
+    glBindVertexArray(0);
+
+    m_stats.commands = (uint32_t)m_cmds.size();
+    m_stats.switches = m_state.counts();
+    m_cmds.clear();
+}
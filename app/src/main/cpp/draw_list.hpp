@@ -0,0 +1,81 @@
+// draw_list.hpp - per-frame sort-keyed draw list shared by UiRenderer and TextRenderer
+#pragma once
+
+#include <GLES3/gl3.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+enum class BlendMode : uint8_t {
+    Premultiplied, // GL_ONE, GL_ONE_MINUS_SRC_ALPHA (UiRenderer)
+    Straight,      // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA (TextRenderer)
+};
+
+// Shadow of the GL state the renderers switch between commands: program,
+// GL_TEXTURE_2D on unit 0, blend func. Calls that match the shadow are
+// skipped; the rest are counted.
+class GpuState {
+public:
+    struct Counts {
+        uint32_t program = 0;
+        uint32_t texture = 0;
+        uint32_t blend = 0;
+    };
+
+    void reset() { m_prog = kUnknown; m_tex = kUnknown; m_blendKnown = false; }
+    void useProgram(GLuint prog);
+    void bindTexture(GLuint tex); // unit 0 (leaves GL_TEXTURE0 active)
+    void blend(BlendMode mode);
+
+    const Counts& counts() const { return m_counts; }
+    void resetCounts() { m_counts = {}; }
+
+private:
+    static constexpr GLuint kUnknown = ~0u;
+    GLuint m_prog = kUnknown;
+    GLuint m_tex = kUnknown;
+    BlendMode m_blend = BlendMode::Premultiplied;
+    bool m_blendKnown = false;
+    Counts m_counts;
+};
+
+// Submissions carry a 64-bit key: layer | depth | program | texture | blend.
+// flush() stable-sorts by key and replays, so z-order is set by (layer, depth)
+// and only commands sharing both - which the submitter declares as not
+// overlapping - are regrouped to share program/texture/blend.
+class DrawList {
+public:
+    // ctx/a/b/c are the submitter's; state binds go through list.state()
+    using Fn = void (*)(void* ctx, uint32_t a, uint32_t b, uint32_t c, DrawList& list);
+
+    struct Stats {
+        uint32_t commands = 0;
+        GpuState::Counts switches;
+    };
+
+    void begin(const float* mvp4x4);
+    void submit(uint8_t layer, uint16_t depth, GLuint program, GLuint texture, BlendMode blend,
+                Fn fn, void* ctx, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+    void flush();
+
+    const float* mvp() const { return m_mvp; }
+    GpuState& state() { return m_state; }
+    // last flush()
+    const Stats& stats() const { return m_stats; }
+
+private:
+    struct Cmd {
+        uint64_t key;
+        Fn fn;
+        void* ctx;
+        uint32_t a, b, c;
+        BlendMode blend;
+    };
+    static uint64_t makeKey(uint8_t layer, uint16_t depth, GLuint program, GLuint texture, BlendMode blend);
+
+    std::vector<Cmd> m_cmds;
+    float m_mvp[16] = {};
+    GpuState m_state;
+    Stats m_stats;
+};
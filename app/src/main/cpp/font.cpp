@@ -0,0 +1,71 @@
+// font.cpp
+#include "font.hpp"
+
+#include <map>
+#include <mutex>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.hpp"
+static constexpr char NS[] = "Font";
+using logx = logger::logx<NS>;
+
+namespace Assets {
+
+namespace {
+// weak: the registry never keeps a mapping alive on its own
+std::mutex g_regMx;
+std::map<std::pair<std::string, int>, std::weak_ptr<const FontMapping>> g_reg;
+}
+
+std::shared_ptr<const FontMapping> FontMapping::fromFd(int fd) {
+    struct stat st{};
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+        logx::Ef("fromFd: fstat failed (fd={} errno={})", fd, errno);
+        return nullptr;
+    }
+    const size_t size = (size_t)st.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        logx::Ef("fromFd: mmap failed ({} bytes, errno={})", size, errno);
+        return nullptr;
+    }
+    return std::shared_ptr<const FontMapping>(new FontMapping(addr, size));
+}
+std::shared_ptr<const FontMapping> FontMapping::acquire(const std::string& path, int collectionIndex) {
+    std::lock_guard<std::mutex> lk(g_regMx);
+    auto& slot = g_reg[{path, collectionIndex}];
+    if (auto m = slot.lock()) return m;
+
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        logx::Ef("acquire: open failed: {} (errno={})", path, errno);
+        g_reg.erase({path, collectionIndex});
+        return nullptr;
+    }
+    // the mapping outlives the fd
+    auto m = fromFd(fd);
+    close(fd);
+    if (!m) {
+        g_reg.erase({path, collectionIndex});
+        return nullptr;
+    }
+    slot = m;
+    logx::If("acquire: mapped {} #{} ({} bytes)", path, collectionIndex, m->size());
+    return m;
+}
+
+FontMapping::~FontMapping() {
+    if (m_addr) munmap(m_addr, m_size);
+    // drop expired registry entries so the map doesn't grow with every font ever used
+    std::lock_guard<std::mutex> lk(g_regMx);
+    for (auto it = g_reg.begin(); it != g_reg.end(); ) {
+        it = it->second.expired() ? g_reg.erase(it) : std::next(it);
+    }
+}
+
+}
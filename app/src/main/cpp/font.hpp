@@ -0,0 +1,57 @@
+// font.hpp - font bytes + face selection, shared by Assets::Manager and the text pipeline
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "asset_view.hpp"
+
+namespace Assets {
+
+// Read-only mmap of a font file. FreeType only reads it (FT_OPEN_MEMORY), so
+// every Font opened from the same (path, collection index) shares one mapping
+// through a process-wide registry; it is unmapped with the last reference.
+class FontMapping {
+public:
+    // nullptr if the file can't be opened or mapped
+    static std::shared_ptr<const FontMapping> acquire(const std::string& path, int collectionIndex = 0);
+    // Maps an already open fd (not closed here). Not registered: nothing to key it by.
+    static std::shared_ptr<const FontMapping> fromFd(int fd);
+
+    ~FontMapping();
+    FontMapping(const FontMapping&) = delete;
+    FontMapping& operator=(const FontMapping&) = delete;
+
+    const char* data() const { return static_cast<const char*>(m_addr); }
+    size_t size() const { return m_size; }
+
+private:
+    FontMapping(void* addr, size_t size) : m_addr(addr), m_size(size) {}
+
+    void* m_addr = nullptr;
+    size_t m_size = 0;
+};
+
+struct Font {
+    std::shared_ptr<const FontMapping> mapping{};
+    AssetView view{};          // a font packed in the asset bundle
+    std::vector<char> bytes{}; // owned copy, used when there is neither
+    int collectionIndex{0};
+    std::vector<std::pair<uint32_t, float>> variationSettings{};
+
+    const char* data() const { return mapping ? mapping->data() : !view.empty() ? view.data() : bytes.data(); }
+    size_t size() const { return mapping ? mapping->size() : !view.empty() ? view.size() : bytes.size(); }
+    bool empty() const { return size() == 0; }
+
+    Font() = default;
+    Font(const Font&) = delete;
+    Font& operator=(const Font&) = delete;
+    Font(Font&&) noexcept = default;
+    Font& operator=(Font&&) noexcept = default;
+};
+
+}
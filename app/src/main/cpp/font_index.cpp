@@ -0,0 +1,268 @@
+// font_index.cpp
+#include "font_index.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifdef __ANDROID__
+#include <android/system_fonts.h>
+#endif
+
+#include "logging.hpp"
+static constexpr char NS[] = "FontIdx";
+using logx = logger::logx<NS>;
+
+namespace fs = std::filesystem;
+
+namespace Assets {
+
+static constexpr char kMagic[] = "fontindex 1";
+
+static std::string lower(std::string_view s) {
+    std::string out(s);
+    for (char& c : out) c = (char)std::tolower((unsigned char)c);
+    return out;
+}
+static std::string_view baseName(std::string_view path) {
+    const size_t p = path.find_last_of('/');
+    return (p == std::string_view::npos) ? path : path.substr(p + 1);
+}
+static std::string_view stemOf(std::string_view path) {
+    std::string_view b = baseName(path);
+    const size_t dot = b.find_last_of('.');
+    return (dot == std::string_view::npos) ? b : b.substr(0, dot);
+}
+static std::string_view familyOf(std::string_view path) {
+    std::string_view s = stemOf(path);
+    return s.substr(0, s.find('-'));
+}
+static bool isFontFile(const fs::path& p) {
+    const std::string ext = lower(p.extension().string());
+    return ext == ".ttf" || ext == ".otf" || ext == ".ttc" || ext == ".otc";
+}
+
+// "Family-SemiBoldItalic" -> 600, italic; compound names first so "bold" doesn't eat "semibold"
+static void parseStyle(std::string_view stem, int& weight, bool& italic) {
+    const size_t dash = stem.find('-');
+    const std::string s = lower(dash == std::string_view::npos ? std::string_view{} : stem.substr(dash + 1));
+    static constexpr std::pair<const char*, int> kWeights[] = {
+        {"extralight", 200}, {"ultralight", 200}, {"semibold", 600}, {"demibold", 600},
+        {"extrabold", 800}, {"ultrabold", 800}, {"thin", 100}, {"hairline", 100},
+        {"light", 300}, {"medium", 500}, {"bold", 700}, {"black", 900}, {"heavy", 900},
+    };
+    weight = 400;
+    for (const auto& [name, w] : kWeights) {
+        if (s.find(name) != std::string::npos) { weight = w; break; }
+    }
+    italic = s.find("italic") != std::string::npos || s.find("oblique") != std::string::npos;
+}
+static std::string styleName(int weight, bool italic) {
+    static constexpr const char* kNames[] = {
+        "Thin", "ExtraLight", "Light", "Regular", "Medium", "SemiBold", "Bold", "ExtraBold", "Black",
+    };
+    const int i = std::clamp((weight + 50) / 100, 1, 9) - 1;
+    if (!italic) return kNames[i];
+    return (i == 3) ? "Italic" : std::string(kNames[i]) + "Italic";
+}
+
+// FNV-1a over (path, size, mtime) of every file under dirs; a stat
+// per file, no reads. Sorted so iteration order doesn't matter.
+static void hashBytes(uint64_t& h, const void* p, size_t n) {
+    const auto* b = static_cast<const unsigned char*>(p);
+    for (size_t i = 0; i < n; i++) { h ^= b[i]; h *= 0x100000001b3ull; }
+}
+static void hashFile(uint64_t& h, const fs::path& p) {
+    std::error_code ec;
+    const uint64_t size = (uint64_t)fs::file_size(p, ec);
+    const int64_t mtime = (int64_t)fs::last_write_time(p, ec).time_since_epoch().count();
+    const std::string s = p.string();
+    hashBytes(h, s.data(), s.size());
+    hashBytes(h, &size, sizeof(size));
+    hashBytes(h, &mtime, sizeof(mtime));
+}
+static std::vector<fs::path> listFonts(const std::string& dir) {
+    std::vector<fs::path> out;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        if (it->is_regular_file(ec) && isFontFile(it->path())) out.push_back(it->path());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+static std::string fingerprintOf(const std::vector<std::string>& dirs, const std::vector<std::string>& files) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (const auto& d : dirs) {
+        for (const auto& p : listFonts(d)) hashFile(h, p);
+    }
+    for (const auto& f : files) hashFile(h, f);
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+    return buf;
+}
+
+/* ---------------- sources ---------------- */
+std::string DirFontSource::fingerprint() const {
+    return fingerprintOf({m_dir}, {});
+}
+void DirFontSource::enumerate(const std::function<void(FontFace&&)>& fn) const {
+    for (const auto& p : listFonts(m_dir)) {
+        FontFace f{};
+        f.path = p.string();
+        f.family = familyOf(f.path);
+        parseStyle(stemOf(f.path), f.weight, f.italic);
+        f.style = styleName(f.weight, f.italic);
+        fn(std::move(f));
+    }
+}
+
+#ifdef __ANDROID__
+std::string SystemFontSource::fingerprint() const {
+    // font partitions + updatable fonts, and the config that maps families onto them
+    return fingerprintOf({"/system/fonts", "/product/fonts", "/system_ext/fonts", "/data/fonts/files"},
+                         {"/system/etc/fonts.xml"});
+}
+void SystemFontSource::enumerate(const std::function<void(FontFace&&)>& fn) const {
+    ASystemFontIterator* it = ASystemFontIterator_open();
+    if (!it) return;
+    while (AFont* font = ASystemFontIterator_next(it)) {
+        FontFace f{};
+        f.path = AFont_getFontFilePath(font);
+        f.collectionIndex = (int)AFont_getCollectionIndex(font);
+        f.weight = (int)AFont_getWeight(font);
+        f.italic = AFont_isItalic(font);
+        f.family = familyOf(f.path);
+        f.style = styleName(f.weight, f.italic);
+        for (size_t i = 0; i < AFont_getAxisCount(font); ++i) {
+            f.axes.emplace_back(AFont_getAxisTag(font, (uint32_t)i), AFont_getAxisValue(font, (uint32_t)i));
+        }
+        AFont_close(font);
+        fn(std::move(f));
+    }
+    ASystemFontIterator_close(it);
+}
+#endif
+
+/* ---------------- index ---------------- */
+void FontIndex::load(const FontSource& src, const std::string& cachePath) {
+    const std::string fp = src.fingerprint();
+
+    m_fromCache = !cachePath.empty() && read(cachePath, fp);
+    if (!m_fromCache) {
+        build(src);
+        m_fingerprint = fp;
+        if (!cachePath.empty() && !write(cachePath)) logx::Ef("load: could not write {}", cachePath);
+    }
+}
+void FontIndex::build(const FontSource& src) {
+    m_faces.clear();
+    src.enumerate([&](FontFace&& f) { m_faces.push_back(std::move(f)); });
+    rehash();
+}
+void FontIndex::rehash() {
+    m_byFile.clear();
+    m_byName.clear();
+    m_byFamily.clear();
+
+    // One file can list several faces (variable-font instances, collections):
+    // the file name picks the one its own name describes; a family alone
+    // picks upright 400. Otherwise the first enumerated wins.
+    auto keep = [&](std::unordered_map<std::string, uint32_t>& map, std::string key, uint32_t i, auto score) {
+        auto [it, added] = map.emplace(std::move(key), i);
+        if (!added && score(m_faces[i]) < score(m_faces[it->second])) it->second = i;
+    };
+    for (uint32_t i = 0; i < (uint32_t)m_faces.size(); i++) {
+        const FontFace& f = m_faces[i];
+        int fileWeight; bool fileItalic;
+        parseStyle(stemOf(f.path), fileWeight, fileItalic);
+        keep(m_byFile, lower(baseName(f.path)), i, [&](const FontFace& g) {
+            return std::abs(g.weight - fileWeight) + (g.italic != fileItalic) * 1000 + g.collectionIndex * 10000;
+        });
+        keep(m_byName, lower(f.family + "-" + f.style), i, [](const FontFace& g) { return g.collectionIndex; });
+        keep(m_byFamily, lower(f.family), i, [](const FontFace& g) {
+            return std::abs(g.weight - 400) + g.italic * 1000 + g.collectionIndex * 10000;
+        });
+    }
+}
+const FontFace* FontIndex::find(std::string_view name) const {
+    const std::string key = lower(name);
+    if (auto it = m_byFile.find(key); it != m_byFile.end()) return &m_faces[it->second];
+    if (auto it = m_byName.find(lower(stemOf(key))); it != m_byName.end()) return &m_faces[it->second];
+    if (auto it = m_byFamily.find(key); it != m_byFamily.end()) return &m_faces[it->second];
+
+    // what get_font used to do on every call, now only on a miss
+    for (const FontFace& f : m_faces) {
+        if (f.path.find(name) != std::string::npos) return &f;
+    }
+    return nullptr;
+}
+
+// One header line, then a tab-separated line per face:
+// family style path collectionIndex weight italic tag=value,...
+bool FontIndex::read(const std::string& path, const std::string& fingerprint) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+
+    std::string line;
+    if (!std::getline(in, line) || line != std::string(kMagic) + " " + fingerprint) return false;
+
+    std::vector<FontFace> faces;
+    while (std::getline(in, line)) {
+        std::vector<std::string> col;
+        std::stringstream ss(line);
+        for (std::string c; std::getline(ss, c, '\t'); ) col.push_back(std::move(c));
+        if (col.size() != 6 && col.size() != 7) return false;
+
+        FontFace f{};
+        f.family = std::move(col[0]);
+        f.style  = std::move(col[1]);
+        f.path   = std::move(col[2]);
+        char* end = nullptr;
+        f.collectionIndex = (int)std::strtol(col[3].c_str(), &end, 10);
+        f.weight = (int)std::strtol(col[4].c_str(), &end, 10);
+        f.italic = col[5] == "1";
+        if (col.size() == 7) {
+            std::stringstream as(col[6]);
+            for (std::string a; std::getline(as, a, ','); ) {
+                const size_t eq = a.find('=');
+                if (eq == std::string::npos) return false;
+                f.axes.emplace_back((uint32_t)std::strtoul(a.c_str(), nullptr, 10),
+                                    std::strtof(a.c_str() + eq + 1, nullptr));
+            }
+        }
+        faces.push_back(std::move(f));
+    }
+
+    m_faces = std::move(faces);
+    m_fingerprint = fingerprint;
+    rehash();
+    return true;
+}
+bool FontIndex::write(const std::string& path) const {
+    // write-then-rename so a crash mid-write never leaves a valid-looking partial index
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out.is_open()) return false;
+        out << kMagic << ' ' << m_fingerprint << '\n';
+        for (const FontFace& f : m_faces) {
+            out << f.family << '\t' << f.style << '\t' << f.path << '\t' << f.collectionIndex << '\t'
+                << f.weight << '\t' << (f.italic ? 1 : 0);
+            for (size_t i = 0; i < f.axes.size(); i++) {
+                out << (i ? ',' : '\t') << f.axes[i].first << '=' << f.axes[i].second;
+            }
+            out << '\n';
+        }
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    return !ec;
+}
+
+}
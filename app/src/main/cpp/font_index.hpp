@@ -0,0 +1,82 @@
+// font_index.hpp - persistent family/style/file index over a pluggable font source
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Assets {
+
+struct FontFace {
+    std::string family;   // file stem up to the first '-': "SourceSansPro"
+    std::string style;    // from weight/italic: "SemiBold", "BoldItalic", "Regular"
+    std::string path;
+    int collectionIndex{0};
+    int weight{400};
+    bool italic{false};
+    std::vector<std::pair<uint32_t, float>> axes{};
+};
+
+// Where faces come from. fingerprint() must change whenever enumerate() could
+// return something different; it is what invalidates a persisted FontIndex.
+class FontSource {
+public:
+    virtual ~FontSource() = default;
+    virtual std::string fingerprint() const = 0;
+    virtual void enumerate(const std::function<void(FontFace&&)>& fn) const = 0;
+};
+
+// Every .ttf/.otf/.ttc under dir (recursive). Weight and italic come from the
+// file name ("Family-BoldItalic.ttf"); collections list face 0 only.
+class DirFontSource : public FontSource {
+public:
+    explicit DirFontSource(std::string dir) : m_dir(std::move(dir)) {}
+    std::string fingerprint() const override;
+    void enumerate(const std::function<void(FontFace&&)>& fn) const override;
+private:
+    std::string m_dir;
+};
+
+#ifdef __ANDROID__
+// ASystemFontIterator (API 29); fingerprinted over the system font directories.
+class SystemFontSource : public FontSource {
+public:
+    std::string fingerprint() const override;
+    void enumerate(const std::function<void(FontFace&&)>& fn) const override;
+};
+#endif
+
+// Name -> face lookups without touching the source. Names are matched case-
+// insensitively as a file name ("Roboto-Regular.ttf"), "Family-Style", or a
+// bare family (closest to upright 400); a path substring is the last resort.
+class FontIndex {
+public:
+    // Reads cachePath if it was written for src's current fingerprint, else
+    // enumerates src and rewrites it. An empty cachePath just builds.
+    void load(const FontSource& src, const std::string& cachePath);
+    void build(const FontSource& src);
+
+    const FontFace* find(std::string_view name) const;
+    size_t size() const { return m_faces.size(); }
+    bool fromCache() const { return m_fromCache; }
+
+private:
+    bool read(const std::string& path, const std::string& fingerprint);
+    bool write(const std::string& path) const;
+    void rehash();
+
+    std::string m_fingerprint;
+    std::vector<FontFace> m_faces;
+    // lowercase key -> index into m_faces
+    std::unordered_map<std::string, uint32_t> m_byFile;
+    std::unordered_map<std::string, uint32_t> m_byName;   // "family-style"
+    std::unordered_map<std::string, uint32_t> m_byFamily;
+    bool m_fromCache = false;
+};
+
+}
@@ -0,0 +1,78 @@
+// half.hpp - float -> IEEE binary16 conversion (round to nearest even)
+// Scalar fallback plus NEON / F16C / SSE2 paths for 4 values at a time.
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__aarch64__) || (defined(__ARM_NEON) && defined(__ARM_FP) && (__ARM_FP & 2))
+#include <arm_neon.h>
+#define HALF_NEON 1
+#elif defined(__F16C__)
+#include <immintrin.h>
+#define HALF_F16C 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HALF_SSE2 1
+#endif
+
+namespace half {
+
+// Bit-exact with the hardware converters (RNE, overflow -> inf, NaN kept quiet).
+inline uint16_t fromFloat(float f) {
+    uint32_t x = std::bit_cast<uint32_t>(f);
+    const uint32_t sign = (x >> 16) & 0x8000u;
+    x &= 0x7fffffffu;
+
+    if (x >= 0x47800000u) {                    // >= 65536, inf or NaN
+        return (uint16_t)(sign | (x > 0x7f800000u ? 0x7e00u : 0x7c00u));
+    }
+    if (x < 0x38800000u) {                     // below 2^-14: subnormal half or zero
+        // adding 0.5f lines the half subnormal bits up at the bottom of the
+        // float mantissa and lets the FPU do the rounding
+        const float t = std::bit_cast<float>(x) + 0.5f;
+        return (uint16_t)(sign | (std::bit_cast<uint32_t>(t) - 0x3f000000u));
+    }
+    const uint32_t mantOdd = (x >> 13) & 1u;
+    x += 0xc8000fffu + mantOdd;                // rebias exponent (127 -> 15), round
+    return (uint16_t)(sign | (x >> 13));
+}
+
+// src[0..3] -> dst[0..3]; src/dst need no particular alignment.
+inline void fromFloat4(const float* src, uint16_t* dst) {
+#if defined(HALF_NEON)
+    vst1_u16(dst, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src))));
+#elif defined(HALF_F16C)
+    _mm_storel_epi64((__m128i*)dst, _mm_cvtps_ph(_mm_loadu_ps(src), _MM_FROUND_TO_NEAREST_INT));
+#elif defined(HALF_SSE2)
+    // fromFloat() above, four lanes at once
+    const __m128i x0   = _mm_castps_si128(_mm_loadu_ps(src));
+    const __m128i sign = _mm_and_si128(x0, _mm_set1_epi32((int)0x80000000u));
+    const __m128i x    = _mm_xor_si128(x0, sign);
+
+    const __m128i big  = _mm_cmpgt_epi32(x, _mm_set1_epi32(0x477fffff));
+    const __m128i nan  = _mm_cmpgt_epi32(x, _mm_set1_epi32(0x7f800000));
+    const __m128i inf  = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(nan, _mm_set1_epi32(0x0200)));
+
+    const __m128i sub  = _mm_cmplt_epi32(x, _mm_set1_epi32(0x38800000));
+    const __m128i subr = _mm_sub_epi32(
+        _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(x), _mm_set1_ps(0.5f))),
+        _mm_set1_epi32(0x3f000000));
+
+    const __m128i odd  = _mm_and_si128(_mm_srli_epi32(x, 13), _mm_set1_epi32(1));
+    const __m128i norm = _mm_srli_epi32(
+        _mm_add_epi32(_mm_add_epi32(x, _mm_set1_epi32((int)0xc8000fffu)), odd), 13);
+
+    __m128i r = _mm_or_si128(_mm_and_si128(sub, subr), _mm_andnot_si128(sub, norm));
+    r = _mm_or_si128(_mm_and_si128(big, inf), _mm_andnot_si128(big, r));
+    r = _mm_or_si128(r, _mm_srli_epi32(sign, 16));
+
+    // sign-extend so the signed-saturating pack keeps the 16-bit pattern
+    r = _mm_srai_epi32(_mm_slli_epi32(r, 16), 16);
+    _mm_storel_epi64((__m128i*)dst, _mm_packs_epi32(r, r));
+#else
+    for (int i = 0; i < 4; i++) dst[i] = fromFloat(src[i]);
+#endif
+}
+
+} // namespace half
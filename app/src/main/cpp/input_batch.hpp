@@ -0,0 +1,100 @@
+// input_batch.hpp - touch input coalesced per frame: every pointer, historical samples
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+struct TouchSample {
+    float x, y;
+    int64_t t_ns; // CLOCK_MONOTONIC, like AMotionEvent_getEventTime
+};
+
+// A pointer going down or up, in arrival order. Moves never produce edges;
+// they only extend the pointer's path.
+struct TouchEdge {
+    enum class Kind : uint8_t { Down, Up, Cancel };
+    Kind kind;
+    int32_t id;
+    TouchSample at;
+};
+
+// Everything the touch panel reported between two frames. The producer
+// appends (down/move/up); the consumer handles the edges in order and then
+// each pointer's path once, however many samples a 120-240 Hz panel
+// delivered. clear() keeps all capacity, so a steady stream allocates
+// nothing.
+class InputBatch {
+public:
+    struct Pointer {
+        int32_t id;
+        std::vector<TouchSample> path; // oldest first, historical samples included
+    };
+
+    void down(int32_t id, float x, float y, int64_t t_ns) {
+        // a new contact: drop whatever path the id had earlier in this batch
+        // (its final position is in that contact's Up edge)
+        Pointer& p = slot(id);
+        m_samples -= p.path.size();
+        p.path.clear();
+        edge(TouchEdge::Kind::Down, id, x, y, t_ns);
+    }
+    void move(int32_t id, float x, float y, int64_t t_ns) {
+        Pointer& p = slot(id);
+        // MOVE repeats pointers that didn't move; keep one sample per position
+        if (!p.path.empty() && p.path.back().x == x && p.path.back().y == y) return;
+        p.path.push_back({x, y, t_ns});
+        m_samples++;
+        seen(t_ns);
+    }
+    void up(int32_t id, float x, float y, int64_t t_ns, bool cancel) {
+        edge(cancel ? TouchEdge::Kind::Cancel : TouchEdge::Kind::Up, id, x, y, t_ns);
+    }
+
+    bool empty() const { return m_edges.empty() && m_samples == 0; }
+    void clear() {
+        m_edges.clear();
+        for (size_t i = 0; i < m_used; i++) m_ptrs[i].path.clear();
+        m_used = 0;
+        m_samples = 0;
+        m_oldest = 0;
+    }
+
+    const std::vector<TouchEdge>& edges() const { return m_edges; }
+    std::span<const Pointer> pointers() const { return {m_ptrs.data(), m_used}; }
+    const Pointer* find(int32_t id) const {
+        for (size_t i = 0; i < m_used; i++) {
+            if (m_ptrs[i].id == id) return &m_ptrs[i];
+        }
+        return nullptr;
+    }
+    // path samples across all pointers
+    size_t samples() const { return m_samples; }
+    // earliest event time in the batch, 0 if empty
+    int64_t oldest_ns() const { return m_oldest; }
+
+private:
+    Pointer& slot(int32_t id) {
+        for (size_t i = 0; i < m_used; i++) {
+            if (m_ptrs[i].id == id) return m_ptrs[i];
+        }
+        if (m_used == m_ptrs.size()) m_ptrs.emplace_back();
+        Pointer& p = m_ptrs[m_used++];
+        p.id = id;
+        return p;
+    }
+    void edge(TouchEdge::Kind kind, int32_t id, float x, float y, int64_t t_ns) {
+        m_edges.push_back({kind, id, {x, y, t_ns}});
+        seen(t_ns);
+    }
+    void seen(int64_t t_ns) {
+        if (t_ns && (!m_oldest || t_ns < m_oldest)) m_oldest = t_ns;
+    }
+
+    std::vector<TouchEdge> m_edges;
+    std::vector<Pointer> m_ptrs; // [0, m_used) live this batch, the rest keep capacity
+    size_t m_used = 0;
+    size_t m_samples = 0;
+    int64_t m_oldest = 0;
+};
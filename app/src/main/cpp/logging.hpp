@@ -1,6 +1,10 @@
 #pragma once
 
+#ifdef __ANDROID__
 #include <android/log.h>
+#else
+#include <cstdio>
+#endif
 #include "fmt.hpp"
 #include <string>
 #include <string_view>
@@ -15,6 +19,7 @@ namespace logger {
 template <const char *NS>
 struct logx {
     static constexpr const std::string TAG = std::string{PROGRAM_NAME} + "::" + NS;
+#ifdef __ANDROID__
     static int I(std::string_view msg) {
         return __android_log_print(ANDROID_LOG_INFO, TAG.c_str(), "%.*s",
                                    (int)msg.size(), msg.data());
@@ -23,6 +28,17 @@ struct logx {
         return __android_log_print(ANDROID_LOG_ERROR, TAG.c_str(), "%.*s",
                                    (int)msg.size(), msg.data());
     }
+#else
+    // Host builds (bench/tools): same tags, stderr instead of logcat
+    static int I(std::string_view msg) {
+        return std::fprintf(stderr, "I/%s: %.*s\n", TAG.c_str(),
+                            (int)msg.size(), msg.data());
+    }
+    static int E(std::string_view msg) {
+        return std::fprintf(stderr, "E/%s: %.*s\n", TAG.c_str(),
+                            (int)msg.size(), msg.data());
+    }
+#endif
     
     // Compile-time checked formatting (C++20)
     template <class... Args>
@@ -10,6 +10,7 @@
 #include <android/asset_manager_jni.h>
 
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES3/gl31.h>
 
 #include <cstdint>
@@ -17,10 +18,24 @@
 #include <cstring>
 #include <cstdio>
 #include <cstddef>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
 //#include <cmath>
 
 #include "ui_renderer.hpp"
 #include "text_renderer.hpp"
+#include "async_loader.hpp"
+#include "program_cache.hpp"
+#include "shader_library.hpp"
+#include "spsc_queue.hpp"
+#include "damage.hpp"
+#include "profiler.hpp"
+#include "input_batch.hpp"
 
 // Very small linear cache for demo.
 #define GLYPH_CACHE_MAX 512
@@ -60,6 +75,11 @@ struct Renderer {
     EGLSurface surface = EGL_NO_SURFACE;
     EGLContext context = EGL_NO_CONTEXT;
     int32_t width = 0, height = 0;
+    bool srgb = false; // window surface encodes sRGB on write
+    // Partial presentation (see repaint_region / present)
+    PFNEGLSETDAMAGEREGIONKHRPROC set_damage_region = nullptr;      // EGL_KHR_partial_update
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swap_with_damage = nullptr; // KHR or EXT, same signature
+    bool buffer_age = false;                                       // EGL_BUFFER_AGE_KHR can be queried
     struct Insets {
         int32_t status_bar_height = 0;
     } insets;
@@ -75,9 +95,27 @@ struct Buttons {
     Btn b[10];
     TextRenderer btext;
 };
+struct App;
+// Main thread -> render thread, applied in order at the start of the next
+// frame. Keys are sent as plain events (touch goes through App::touch);
+// anything else that edits the renderers (setText, objRectFilled, ...) as a
+// Call run on the render thread.
+struct RenderCmd {
+    enum class Kind : uint8_t { Key, Call };
+    Kind kind = Kind::Call;
+    int32_t action = 0;
+    int32_t key = 0;
+    int64_t event_ns = 0; // AInputEvent time: CLOCK_MONOTONIC, same as steady_clock
+    std::function<void(App*)> fn;
+};
 struct App {
     Assets::Manager asset_mgr;
     Renderer r;
+    // linked programs from earlier runs, in internalDataPath
+    GlesProgramGl prog_gl;
+    ProgramCache prog_cache{prog_gl, asset_mgr.data_path()};
+    // every program of the context; before the renderers, which release into it
+    ShaderLibrary shaders{&prog_cache};
     // Ui
     UiRenderer ui;
     Buttons buttons;
@@ -87,9 +125,77 @@ struct App {
     TextRenderer::Handle activeText{-1};
     TextRenderer::Handle t0{}, t1{}, t2{}, t3{}, t4{};
     bool text_ready = false;
+    // UI + text for one frame, sorted and replayed in render()
+    DrawList draw_list;
+    // What the renderers changed since the last presented frame; render()
+    // repaints only that (plus what the back buffer is missing) and skips
+    // the swap when it is empty
+    Damage damage;
+    struct Present {
+        Damage history[3];   // damage of the last presented frames, [0] = newest
+        uint32_t frames = 0;
+        uint32_t partial = 0;
+    } present;
+    // per-phase frame timings; on with -DFRAME_PROFILE, dumped as a Chrome
+    // trace into internalDataPath when the window goes away
+    Profiler prof;
+    // Window init: reads, font parsing and glyph prewarm run on the loader;
+    // the render thread draws placeholder frames and does the GL half as the
+    // futures complete (start_loading / finish_loading)
+    struct Loading {
+        std::future<Assets::AssetView> ui_vs, ui_fs, text_vs, text_fs;
+        std::future<bool> text, btext; // CPU half of a->text / a->buttons.btext
+        bool active = false;
+        // every program is requested once all shader sources are read; each
+        // part's GL half then waits for its programs to link
+        bool ui_linking = false, text_linking = false;
+        bool text_requested = false; // text programs requested without error
+    } loading;
+    std::chrono::steady_clock::time_point window_t0{};
+    bool first_frame = false;
+    // this frame's touch input (taken from touch.pending) and the pointer
+    // driving the text selection, -1 = none
+    InputBatch touch_frame;
+    int32_t select_pointer = -1;
+
+    // Everything above belongs to the render thread (render_main). The main
+    // thread only pushes into cmds and hands over windows through life.
+    SpscQueue<RenderCmd, 256> cmds;
+    uint32_t cmds_dropped = 0; // main thread
+    // Motion events accumulate here between frames (every pointer, historical
+    // samples included); the render thread swaps the batch out once per frame.
+    struct Touch {
+        std::mutex mx;
+        InputBatch pending;
+    } touch;
+    // set_window() blocks until the render thread has brought EGL up on the
+    // new window or torn it down: after TERM_WINDOW returns the window is gone.
+    struct Lifecycle {
+        std::mutex mx;
+        std::condition_variable cv;
+        ANativeWindow* window = nullptr;
+        bool pending = false;
+        bool quit = false;
+        std::atomic<bool> changed{false}; // pending || quit, read every frame without mx
+    } life;
+    // input -> eglSwapBuffers return, for frames that applied input
+    struct Latency {
+        int64_t oldest_ns = 0; // oldest input applied this frame
+        double sum_ms = 0.0, max_ms = 0.0;
+        uint32_t frames = 0;
+    } latency;
+    // bumped by the main thread for every command and window change; the
+    // render thread sleeps on it while nothing needs drawing
+    std::atomic<uint32_t> wake{0};
+    std::thread render_thread;
+    // last: its destructor waits for jobs that still reference the members above
+    AsyncLoader loader{2};
     
     App(android_app* app) : asset_mgr(app) {}
 };
+static double ms_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
 
 /* ---------------- EGL init/destroy ---------------- */
 static bool init_egl(Renderer* r, ANativeWindow* window) {
@@ -127,7 +233,18 @@ static bool init_egl(Renderer* r, ANativeWindow* window) {
 
     ANativeWindow_setBuffersGeometry(window, 0, 0, vid);
 
-    r->surface = eglCreateWindowSurface(r->display, cfg, window, NULL);
+    // sRGB surface where supported: blending happens in linear light and the
+    // UI shaders skip their own encode (UiRenderer::setColorOutput)
+    r->srgb = false;
+    const char* exts = eglQueryString(r->display, EGL_EXTENSIONS);
+    if (exts && std::strstr(exts, "EGL_KHR_gl_colorspace")) {
+        const EGLint surf_attr[] = { EGL_GL_COLORSPACE_KHR, EGL_GL_COLORSPACE_SRGB_KHR, EGL_NONE };
+        r->surface = eglCreateWindowSurface(r->display, cfg, window, surf_attr);
+        r->srgb = r->surface != EGL_NO_SURFACE;
+        if (!r->srgb) egl_log_error("eglCreateWindowSurface(sRGB)");
+    }
+    if (r->surface == EGL_NO_SURFACE) r->surface = eglCreateWindowSurface(r->display, cfg, window, NULL);
+    logx::If("EGL: sRGB surface={}", r->srgb);
     if (r->surface == EGL_NO_SURFACE) { logx::E("EGL: eglCreateWindowSurface failed"); egl_log_error("eglCreateWindowSurface"); return false; }
 
     const EGLint ctx_attr[] = { 
@@ -147,6 +264,18 @@ static bool init_egl(Renderer* r, ANativeWindow* window) {
     glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &mvs);
     logx::If("GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS={}", mvs);
 
+    // repaint/present only what changed; without these every frame is full
+    auto has_ext = [exts](const char* name) { return exts && std::strstr(exts, name); };
+    r->set_damage_region = has_ext("EGL_KHR_partial_update")
+        ? (PFNEGLSETDAMAGEREGIONKHRPROC)eglGetProcAddress("eglSetDamageRegionKHR") : nullptr;
+    r->swap_with_damage = has_ext("EGL_KHR_swap_buffers_with_damage")
+        ? (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress("eglSwapBuffersWithDamageKHR")
+        : has_ext("EGL_EXT_swap_buffers_with_damage")
+        ? (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress("eglSwapBuffersWithDamageEXT") : nullptr;
+    r->buffer_age = has_ext("EGL_KHR_partial_update") || has_ext("EGL_EXT_buffer_age");
+    logx::If("EGL: partial_update={} swap_with_damage={} buffer_age={}",
+             r->set_damage_region != nullptr, r->swap_with_damage != nullptr, r->buffer_age);
+
     eglQuerySurface(r->display, r->surface, EGL_WIDTH,  (EGLint*)&r->width);
     eglQuerySurface(r->display, r->surface, EGL_HEIGHT, (EGLint*)&r->height);
     logx::If("EGL: surface {}x{}", r->width, r->height);
@@ -243,12 +372,35 @@ static void init_buttons(float scr_w, float scr_h, UiRenderer& ui, Buttons& b) {
     }
     
 }
+// All UI and text programs in flight together, so the driver's compiler
+// threads (KHR_parallel_shader_compile) get them as one batch; nothing here
+// waits on a link.
+static void request_programs(App* a, const Assets::AssetView& ui_vs, const Assets::AssetView& ui_fs,
+                             const Assets::AssetView& text_vs, const Assets::AssetView& text_fs) {
+    App::Loading& l = a->loading;
+    a->ui.setColorOutput(a->r.srgb);
+    a->ui.setShaderLibrary(&a->shaders);
+    l.ui_linking = a->ui.request(ui_vs, ui_fs);
+    if (!l.ui_linking) logx::E("ui.request failed");
+
+    a->text.setSrgbTarget(a->r.srgb);
+    a->buttons.btext.setSrgbTarget(a->r.srgb);
+    // one text program for both: they differ only in font
+    a->text.setShaderLibrary(&a->shaders);
+    a->buttons.btext.setShaderLibrary(&a->shaders);
+    // initGl() only requests, it doesn't race the initFont() jobs
+    l.text_requested = a->text.initGl(text_vs, text_fs) && a->buttons.btext.initGl(text_vs, text_fs);
+    if (!l.text_requested) logx::E("text program request failed");
+    l.text_linking = true; // still waits for the font jobs
+}
 static bool init_ui(struct android_app* app) {
     using namespace bitmask;
     
     App* a = (App*)app->userData;
-    if (!a->ui.init(a->asset_mgr)) { 
-        logx::E("ui.init failed"); 
+    a->ui.setDamage(&a->damage);
+    a->ui.setProfiler(&a->prof);
+    if (!a->ui.finishInit()) { 
+        logx::E("ui.finishInit failed"); 
         return false; 
     }
     JavaHack::SBarInsets sbar_i = JavaHack::get_SBarInsets(app);
@@ -270,17 +422,22 @@ static bool init_ui(struct android_app* app) {
     a->ui_ready = true;
     return true;
 }
-static bool init_text(struct android_app* app) {
-    constexpr auto *font_name{"SourceSansPro-SemiBold.ttf"};
-    App* a = (App*)app->userData;
-    if (!a->text.init(a->asset_mgr, font_name, 48, 2048, 2048)) {
-        logx::E("a->text.init failed");
+static bool init_text(App* a, bool programs, bool text_font, bool btext_font) {
+    if (!programs || !text_font) {
+        logx::E("a->text init failed");
         return false;
     }
-    if (!a->buttons.btext.init(a->asset_mgr, font_name, 160, 2048, 2048)) {
-        logx::E("a->buttons.btext.init failed");
+    if (!btext_font) {
+        logx::E("a->buttons.btext init failed");
         return false;
     }
+    // labels can share transform slots with their UI objects
+    a->text.setXformTable(&a->ui.xforms());
+    a->buttons.btext.setXformTable(&a->ui.xforms());
+    a->text.setDamage(&a->damage);
+    a->buttons.btext.setDamage(&a->damage);
+    a->text.setProfiler(&a->prof);
+    a->buttons.btext.setProfiler(&a->prof);
     /*a->t0 = a->text.createText();
     a->text.setPos(a->t0, 500.0f, 1500.0f);
     a->text.setColor(a->t0, {255,255,255,255});
@@ -297,11 +454,192 @@ static bool init_text(struct android_app* app) {
     return true;
 }
 
-/* ---------------- Render ---------------- */
-static void render(App* a) {
-    glClearColor(0.08f, 0.10f, 0.12f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+/* ---------------- Loading ---------------- */
+static void start_loading(App* a) {
+    constexpr auto *font_name{"SourceSansPro-SemiBold.ttf"};
+    App::Loading& l = a->loading;
+    l.ui_vs   = a->loader.readAsset(a->asset_mgr, "shaders/ui.vert");
+    l.ui_fs   = a->loader.readAsset(a->asset_mgr, "shaders/ui.frag");
+    l.text_vs = a->loader.readAsset(a->asset_mgr, "shaders/text.vert");
+    l.text_fs = a->loader.readAsset(a->asset_mgr, "shaders/text.frag");
+    // until text_ready this thread only requests their programs (initGl)
+    l.text = a->loader.submit([a] {
+        return a->text.initFont(a->asset_mgr.get_font(font_name), 48, 2048, 2048);
+    });
+    l.btext = a->loader.submit([a] {
+        // numpad labels, so their first frame doesn't rasterize; baked into
+        // the bundle by mkbundle --atlas when it was built with one
+        if (!a->buttons.btext.initFont(a->asset_mgr.get_font(font_name), 160, 2048, 2048)) return false;
+        const Assets::AssetView baked = a->asset_mgr.baked(Assets::atlasName(font_name, 160));
+        return (!baked.empty() && a->buttons.btext.loadAtlas(baked)) ||
+               a->buttons.btext.prewarm("0123456789");
+    });
+    l.active = true;
+}
+// GL half of loading, on the render thread, each part once its futures are ready.
+static void finish_loading(struct android_app* app) {
+    App* a = (App*)app->userData;
+    App::Loading& l = a->loading;
+
+    if (l.ui_vs.valid() && AsyncLoader::ready(l.ui_vs) && AsyncLoader::ready(l.ui_fs) &&
+        AsyncLoader::ready(l.text_vs) && AsyncLoader::ready(l.text_fs)) {
+        const auto t0 = std::chrono::steady_clock::now();
+        request_programs(a, l.ui_vs.get(), l.ui_fs.get(), l.text_vs.get(), l.text_fs.get());
+        logx::If("request_programs: {:.1f} ms on the render thread", ms_since(t0));
+    }
+    // placeholder frames until a part's programs have linked, so resolving
+    // them below doesn't stall a frame on the driver
+    if (l.ui_linking && a->ui.programsReady()) {
+        l.ui_linking = false;
+        const auto t0 = std::chrono::steady_clock::now();
+        if (!init_ui(app)) logx::E("init_ui failed");
+        logx::If("init_ui: {:.1f} ms on the render thread", ms_since(t0));
+    }
+    if (l.text_linking && AsyncLoader::ready(l.text) && AsyncLoader::ready(l.btext) &&
+        a->text.programReady() && a->buttons.btext.programReady()) {
+        l.text_linking = false;
+        const auto t0 = std::chrono::steady_clock::now();
+        if (!init_text(a, l.text_requested, l.text.get(), l.btext.get())) logx::E("init_text failed");
+        logx::If("init_text: {:.1f} ms on the render thread", ms_since(t0));
+    }
+    if (l.ui_vs.valid() || l.ui_linking || l.text_linking) return;
+
+    l.active = false;
+    if (a->ui_ready && a->text_ready) init_buttons(a->r.width, a->r.height, a->ui, a->buttons);
+    logx::If("Ready: {:.1f} ms after INIT_WINDOW", ms_since(a->window_t0));
+    const ProgramCache::Stats& pc = a->prog_cache.stats();
+    logx::If("program cache: {} hits, {} misses, {} rejected, {} stored", pc.hits, pc.misses, pc.rejected, pc.stored);
+}
+// Jobs write into the text renderers: let them finish before those are torn down.
+static void cancel_loading(App* a) {
+    App::Loading& l = a->loading;
+    if (l.text.valid()) l.text.wait();
+    if (l.btext.valid()) l.btext.wait();
+    l = App::Loading{};
+}
+
+#ifdef UI_BENCH
+// Times every UiRenderer instance backend the device supports: a static
+// redraw, a rebuild + re-upload + redraw of kObjs x kRects rects, and a
+// per-element recolor of one rect per object + redraw.
+// glFinish() per frame, so numbers include GPU time.
+static void bench_ui_backends(App* a) {
+    using clock = std::chrono::steady_clock;
+    constexpr int kObjs = 50, kRects = 24, kFrames = 120;
+    constexpr UiRenderer::Backend kBackends[] = {
+        UiRenderer::Backend::Texture,
+        UiRenderer::Backend::Attrib,
+        UiRenderer::Backend::Ssbo,
+    };
+    Mat4 mvp = Mat4::ortho(0.0f, (float)a->r.width, (float)a->r.height, 0.0f);
+    const float cw = (float)a->r.width / kRects;
+    const float ch = (float)a->r.height / kObjs;
+
+    for (UiRenderer::Backend want : kBackends) {
+        UiRenderer ui;
+        ui.setColorOutput(a->r.srgb);
+        if (!ui.init(a->asset_mgr, want) || ui.backend() != want) {
+            logx::If("ui bench: {} unsupported", UiRenderer::backendName(want));
+            continue;
+        }
+
+        std::vector<UiRenderer::Handle> objs;
+        std::vector<UiRenderer::Elem> elems(kObjs * kRects);
+        for (int o = 0; o < kObjs; o++) objs.push_back(ui.createObj());
+        auto fill = [&](int frame) {
+            for (int o = 0; o < kObjs; o++) {
+                ui.objClear(objs[o]);
+                for (int r = 0; r < kRects; r++) {
+                    const uint8_t c = (uint8_t)((o * 7 + r * 3 + frame) & 0xff);
+                    elems[o * kRects + r] = ui.objRectFilled(objs[o], r * cw, o * ch, cw - 2.0f, ch - 2.0f,
+                                                             {{c, 0x40, (uint8_t)(0xff - c), 0xff}}, 6.0f);
+                }
+            }
+        };
+        auto edit = [&](int frame) {
+            for (int o = 0; o < kObjs; o++) {
+                const uint8_t c = (uint8_t)((o * 7 + frame) & 0xff);
+                ui.objSetColors(objs[o], elems[o * kRects + frame % kRects], {{c, 0x40, (uint8_t)(0xff - c), 0xff}});
+            }
+        };
+        auto frame = [&] {
+            glClear(GL_COLOR_BUFFER_BIT);
+            ui.drawObjects(mvp.data());
+            glFinish();
+        };
+
+        fill(0);
+        frame(); // warm-up: first upload + shader/pipeline setup
+
+        auto t0 = clock::now();
+        for (int f = 0; f < kFrames; f++) frame();
+        auto t1 = clock::now();
+        for (int f = 0; f < kFrames; f++) { fill(f); frame(); }
+        auto t2 = clock::now();
+        for (int f = 0; f < kFrames; f++) { edit(f); frame(); }
+        auto t3 = clock::now();
+
+        const double staticMs  = std::chrono::duration<double, std::milli>(t1 - t0).count() / kFrames;
+        const double rebuildMs = std::chrono::duration<double, std::milli>(t2 - t1).count() / kFrames;
+        const double editMs    = std::chrono::duration<double, std::milli>(t3 - t2).count() / kFrames;
+        logx::If("ui bench: {} static {:.3f} ms/frame, rebuild {:.3f} ms/frame, edit {:.3f} ms/frame ({} inst)",
+                 UiRenderer::backendName(want), staticMs, rebuildMs, editMs, kObjs * kRects);
+        ui.shutdown();
+    }
+    gl_check("bench_ui_backends");
+}
+#endif
 
+/* ---------------- Render ---------------- */
+static float srgb_to_linear(float c) {
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+// Region to repaint: this frame's damage plus whatever changed since the
+// back buffer we were handed was last drawn (its age), or everything when
+// that is unknown. Announced with eglSetDamageRegionKHR before any drawing.
+static bool repaint_region(App* a, int& x, int& y, int& w, int& h) {
+    const Renderer& r = a->r;
+    Damage region = a->damage;
+    EGLint age = 0;
+    if (r.buffer_age && !eglQuerySurface(r.display, r.surface, EGL_BUFFER_AGE_KHR, &age)) age = 0;
+    if (age <= 0 || age - 1 > (EGLint)std::size(a->present.history)) {
+        region.setFull();
+    } else {
+        for (EGLint i = 0; i < age - 1; i++) region.add(a->present.history[i]);
+    }
+    if (!region.pixels(r.width, r.height, x, y, w, h)) return false;
+    if (r.set_damage_region) {
+        EGLint rect[4] = { x, r.height - y - h, w, h }; // EGL rects are bottom-left origin
+        r.set_damage_region(r.display, r.surface, rect, 1);
+    }
+    return true;
+}
+// Swap, telling the compositor which part of the frame changed.
+static void present(App* a) {
+    const Renderer& r = a->r;
+    App::Present& p = a->present;
+    int x, y, w, h;
+    if (r.swap_with_damage && !a->damage.full() && a->damage.pixels(r.width, r.height, x, y, w, h)) {
+        EGLint rect[4] = { x, r.height - y - h, w, h };
+        r.swap_with_damage(r.display, r.surface, rect, 1);
+        p.partial++;
+    } else {
+        eglSwapBuffers(r.display, r.surface);
+    }
+    p.frames++;
+    for (size_t i = std::size(p.history) - 1; i > 0; i--) p.history[i] = p.history[i - 1];
+    p.history[0] = a->damage;
+    a->damage.clear();
+}
+// Anything retained (objects, labels, transform slots) changed since the last frame.
+static bool needs_redraw(App* a) {
+    if (!a->damage.empty()) return true;
+    if (a->ui_ready && a->ui.needsRedraw()) return true;
+    return a->text_ready && (a->text.needsRedraw() || a->buttons.btext.needsRedraw());
+}
+// Records and uploads the frame, collecting damage; draws only the damaged
+// region and returns false (nothing to swap) when none of it is on screen.
+static bool render(App* a) {
     Mat4 mvp = Mat4::ortho(0.0f, (float)a->r.width, (float)a->r.height, 0.0f);
     
     if (a->ui_ready) {
@@ -326,22 +664,64 @@ static void render(App* a) {
         }
 
         a->ui.end();
-        
-        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-        a->ui.draw(mvp.data());
-        a->ui.drawObjects(mvp.data());
     }
 
-    // Text
+    // One list for UI and text: z-order from (layer, depth), blend funcs set
+    // per command, program/texture binds shared across renderers.
+    DrawList& dl = a->draw_list;
+    dl.begin(mvp.data());
+    if (a->ui_ready) a->ui.submit(dl);
     if (a->text_ready) {
         a->text.update();
         a->buttons.btext.update();
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        a->text.draw(mvp.data());
-        a->buttons.btext.draw(mvp.data());
+        a->text.submit(dl);
+        a->buttons.btext.submit(dl);
+    }
+
+    // a new surface has nothing to keep; placeholder frames stay vsync-paced
+    // (and full) while they poll the loader
+    if (!a->first_frame || a->loading.active) a->damage.setFull();
+    int x, y, w, h;
+    if (!a->damage.pixels(a->r.width, a->r.height, x, y, w, h) || !repaint_region(a, x, y, w, h)) {
+        a->damage.clear(); // empty or entirely off screen
+        return false;
+    }
+    const bool partial = w < a->r.width || h < a->r.height;
+    if (partial) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(x, a->r.height - y - h, w, h);
+    }
+    if (a->r.srgb) {
+        glClearColor(srgb_to_linear(0.08f), srgb_to_linear(0.10f), srgb_to_linear(0.12f), 1.0f);
+    } else {
+        glClearColor(0.08f, 0.10f, 0.12f, 1.0f);
+    }
+    glClear(GL_COLOR_BUFFER_BIT);
+    {
+        ProfScope ps(&a->prof, ProfPhase::Draw);
+        dl.flush();
+    }
+    if (partial) glDisable(GL_SCISSOR_TEST);
+
+    // upload diffing, state switch and present summaries with the profiler
+    // (FRAME_PROFILE), every 300 rendered frames
+    static uint32_t s_frames = 0;
+    if (a->prof.enabled() && ++s_frames % 300 == 0) {
+        if (a->ui_ready) {
+            const auto& us = a->ui.frameUploadStats();
+            logx::If("ui frame uploads: skipped={} partial={} full={} inst={}",
+                     us.skipped, us.partial, us.full, us.instSent);
+            a->ui.resetFrameUploadStats();
+        }
+        const auto& ds = dl.stats();
+        logx::If("draw list: cmds={} program={} texture={} blend={} switches",
+                 ds.commands, ds.switches.program, ds.switches.texture, ds.switches.blend);
+        logx::If("present: {} of {} frames with damage rect", a->present.partial, a->present.frames);
+        a->prof.logSummary();
     }
 
     gl_check("render end");
+    return true;
 }
 
 /* ---------------- App commands ---------------- */
@@ -352,6 +732,13 @@ void destroy_app(App* a) {
         eglMakeCurrent(a->r.display, a->r.surface, a->r.surface, a->r.context);
     }
 
+    cancel_loading(a);
+
+    const std::string& dir = a->asset_mgr.data_path();
+    if (a->prof.enabled() && !dir.empty() && !a->prof.writeChromeTrace(dir + "/frames.json")) {
+        logx::E("profiler: could not write frames.json");
+    }
+
     a->ui.shutdown();     
     a->ui_ready = false;
 
@@ -359,86 +746,316 @@ void destroy_app(App* a) {
     a->text_ready = false;
 
     a->buttons.btext.shutdown();
+
+    a->shaders.shutdown();
     
     destroy_egl(&a->r);
 }
+static void init_window(struct android_app* app, ANativeWindow* window) {
+    App* a = (App*)app->userData;
+    a->window_t0 = std::chrono::steady_clock::now();
+    a->first_frame = false;
+    a->damage.clear();
+    a->present = App::Present{};
+    a->select_pointer = -1;
+#ifdef FRAME_PROFILE
+    a->prof.setEnabled(true);
+#endif
+    if (!init_egl(&a->r, window)) {
+        logx::E("init_egl failed");
+        return;
+    }
+    glEnable(GL_BLEND);
+#ifdef UI_BENCH
+    bench_ui_backends(a);
+#endif
+    // frames start right away (clear color only) and fill in as
+    // finish_loading() completes each part
+    start_loading(a);
+    logx::If("EGL up: {:.1f} ms after INIT_WINDOW", ms_since(a->window_t0));
+}
+
+/* ---------------- Render thread ---------------- */
+// Main thread: the render thread may be asleep in render_main.
+static void wake_render(App* a) {
+    a->wake.fetch_add(1, std::memory_order_release);
+    a->wake.notify_one();
+}
+// Main thread: hands the window (nullptr = none) over and waits until it has been applied.
+static void set_window(App* a, ANativeWindow* window) {
+    std::unique_lock<std::mutex> lk(a->life.mx);
+    a->life.window = window;
+    a->life.pending = true;
+    a->life.changed.store(true, std::memory_order_release);
+    a->life.cv.notify_all();
+    wake_render(a);
+    a->life.cv.wait(lk, [a] { return !a->life.pending; });
+}
+static void stop_render_thread(App* a) {
+    {
+        std::lock_guard<std::mutex> lk(a->life.mx);
+        a->life.quit = true;
+        a->life.changed.store(true, std::memory_order_release);
+    }
+    a->life.cv.notify_all();
+    wake_render(a);
+    if (a->render_thread.joinable()) a->render_thread.join();
+}
+// Render thread: applies window changes, sleeps while there is no window.
+// false once asked to quit (EGL already torn down).
+static bool sync_lifecycle(struct android_app* app) {
+    App* a = (App*)app->userData;
+    if (a->r.initialized && !a->life.changed.load(std::memory_order_acquire)) return true;
+
+    std::unique_lock<std::mutex> lk(a->life.mx);
+    for (;;) {
+        if (a->life.pending) {
+            if (a->r.initialized) destroy_app(a);
+            if (a->life.window) init_window(app, a->life.window);
+            a->life.pending = false;
+            a->life.cv.notify_all();
+        }
+        if (a->life.quit) {
+            if (a->r.initialized) destroy_app(a);
+            return false;
+        }
+        a->life.changed.store(false, std::memory_order_relaxed);
+        if (a->r.initialized) return true;
+        a->life.cv.wait(lk, [a] { return a->life.pending || a->life.quit; });
+    }
+}
+
+static void apply_input(App* a, const RenderCmd& c) {
+    if (c.kind == RenderCmd::Kind::Key) {
+        // Handle keyboard here
+    }
+}
+// Once per frame, however many samples arrived: edges in order, then one
+// update per pointer from its newest sample. The whole path (a->touch_frame)
+// stays available to anything that needs more than the end point.
+static void dispatch_touch(App* a, const InputBatch& b) {
+    // the loader may still be filling in the text renderers
+    if (!a->text_ready) return;
+    for (const TouchEdge& e : b.edges()) {
+        if (e.kind == TouchEdge::Kind::Down) {
+            if (a->select_pointer != -1) continue; // a second finger doesn't restart the selection
+            a->activeText = a->text.hitTest(e.at.x, e.at.y);
+            if (a->activeText.id != -1) {
+                a->text.beginSelection(a->activeText, e.at.x, e.at.y);
+                a->select_pointer = e.id;
+            }
+        } else if (e.id == a->select_pointer) {
+            if (e.kind == TouchEdge::Kind::Up) a->text.updateSelection(a->activeText, e.at.x, e.at.y);
+            a->text.endSelection(a->activeText);
+            a->select_pointer = -1;
+            // keep activeText if you want caret to remain focused; or clear it:
+            // a->activeText = {-1};
+        }
+    }
+    if (a->select_pointer == -1) return;
+    if (const InputBatch::Pointer* p = b.find(a->select_pointer); p && !p->path.empty()) {
+        a->text.updateSelection(a->activeText, p->path.back().x, p->path.back().y);
+    }
+}
+// Swaps the main thread's batch for this frame's; true if it had anything.
+static bool apply_touch(App* a) {
+    a->touch_frame.clear();
+    {
+        std::lock_guard<std::mutex> lk(a->touch.mx);
+        if (a->touch.pending.empty()) return false;
+        std::swap(a->touch.pending, a->touch_frame);
+    }
+    // without a window the renderers are rebuilt from scratch anyway
+    if (!a->r.initialized) return true;
+    dispatch_touch(a, a->touch_frame);
+    const int64_t t = a->touch_frame.oldest_ns();
+    if (t && (!a->latency.oldest_ns || t < a->latency.oldest_ns)) a->latency.oldest_ns = t;
+    return true;
+}
+// true if there were any
+static bool apply_commands(App* a) {
+    bool any = false;
+    RenderCmd c;
+    while (a->cmds.pop(c)) {
+        any = true;
+        // without a window there is nothing to apply them to: the renderers
+        // are rebuilt from scratch on the next INIT_WINDOW
+        if (a->r.initialized) {
+            if (c.kind == RenderCmd::Kind::Call) {
+                if (c.fn) c.fn(a);
+            } else {
+                apply_input(a, c);
+                if (c.event_ns && (!a->latency.oldest_ns || c.event_ns < a->latency.oldest_ns)) {
+                    a->latency.oldest_ns = c.event_ns;
+                }
+            }
+        }
+        c = RenderCmd{}; // release captures now, not on the next pop
+    }
+    return any;
+}
+// Up to eglSwapBuffers returning; the display adds its own scanout on top.
+static void record_latency(App* a) {
+    App::Latency& l = a->latency;
+    if (!l.oldest_ns) return;
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    const double ms = (double)(now - l.oldest_ns) / 1e6;
+    l.oldest_ns = 0;
+    l.sum_ms += ms;
+    l.max_ms = std::max(l.max_ms, ms);
+    if (++l.frames == 120) {
+        logx::If("input->swap: avg {:.1f} ms, max {:.1f} ms over {} input frames",
+                 l.sum_ms / l.frames, l.max_ms, l.frames);
+        l = App::Latency{};
+    }
+}
+static void render_main(struct android_app* app) {
+    App* a = (App*)app->userData;
+    for (;;) {
+        // read before sync_lifecycle() and the drains: a window change or
+        // command that lands after this has bumped wake past seen, so the
+        // wait below returns at once instead of sleeping through it
+        const uint32_t seen = a->wake.load(std::memory_order_acquire);
+        if (!sync_lifecycle(app)) break;
+        a->prof.beginFrame();
+        bool applied;
+        {
+            ProfScope ps(&a->prof, ProfPhase::Input);
+            applied = apply_commands(a);
+            applied |= apply_touch(a);
+        }
+        const bool loading = a->loading.active;
+        if (loading) {
+            ProfScope ps(&a->prof, ProfPhase::Load);
+            finish_loading(app);
+        }
+        if (!applied && !loading && a->first_frame && !needs_redraw(a)) {
+            a->prof.dropFrame();
+            a->wake.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+        if (!render(a)) {
+            a->prof.dropFrame();
+            a->latency.oldest_ns = 0; // input that changed nothing on screen
+            continue;
+        }
+        {
+            ProfScope ps(&a->prof, ProfPhase::Swap);
+            present(a);
+        }
+        a->prof.endFrame();
+        record_latency(a);
+        if (!a->first_frame) {
+            a->first_frame = true;
+            logx::If("first frame: {:.1f} ms after INIT_WINDOW ({})", ms_since(a->window_t0),
+                     (a->ui_ready && a->text_ready) ? "complete" : "placeholder");
+        }
+    }
+    // JavaHack attached this thread
+    app->activity->vm->DetachCurrentThread();
+}
+
+/* ---------------- Main thread ---------------- */
 static void handle_cmd(struct android_app* app, int32_t cmd) {
     App* a = (App*)app->userData;
 
     switch (cmd) {
         case APP_CMD_INIT_WINDOW:
-            if (app->window && !a->r.initialized) {
-                if (!init_egl(&a->r, app->window)) {
-                    logx::E("init_egl failed");
-                    return;
-                }
-                glEnable(GL_BLEND);
-                
-                if (!init_ui(app)) {
-                    logx::E("init_ui failed");
-                    return;
-                }
-                
-                if (!init_text(app)) {
-                    logx::E("init_text failed");
-                    return;
-                }
-                
-                init_buttons(a->r.width, a->r.height, a->ui, a->buttons);
-    
-                //logx::If("status-bar: %d", a->r.insets.status_bar_height);
-                logx::I("Ready");
-            }
+            if (app->window) set_window(a, app->window);
             break;
 
         case APP_CMD_TERM_WINDOW:
-            // Window is going away; destroy GL/EGL + font resources tied to GL context
-            destroy_app(a);
+            // Window is going away; the render thread destroys GL/EGL + font
+            // resources tied to the context before this returns
+            set_window(a, nullptr);
+            break;
+
+        case APP_CMD_WINDOW_REDRAW_NEEDED: {
+            // the system wants every pixel again, not just what changed
+            RenderCmd c{};
+            c.fn = [](App* a) { a->damage.setFull(); };
+            a->cmds.push(std::move(c));
+            wake_render(a);
             break;
+        }
 
         default:
             break;
     }
 }
-static int32_t handle_input(android_app* app, AInputEvent* event) {
-    App* a = (App*)app->userData;
+// Appends one motion event to the pending touch batch: its historical
+// samples (MOVE batches them at the panel rate) for every pointer, then the
+// current sample or the down/up edge of the pointer the action names.
+static void read_motion(App* a, const AInputEvent* e) {
+    const int32_t action = AMotionEvent_getAction(e);
+    const size_t idx = (size_t)((action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK) >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+    const size_t n = AMotionEvent_getPointerCount(e);
+    const size_t hist = AMotionEvent_getHistorySize(e);
+    const int64_t t = AMotionEvent_getEventTime(e);
 
-    int type = AInputEvent_getType(event);
-    if (type == AINPUT_EVENT_TYPE_MOTION) {
-        int action = AMotionEvent_getAction(event) & AMOTION_EVENT_ACTION_MASK;
-        float x = AMotionEvent_getX(event, 0);
-        float y = AMotionEvent_getY(event, 0);
-    
-        if (action == AMOTION_EVENT_ACTION_DOWN) {
-            a->activeText = a->text.hitTest(x, y);
-            if (a->activeText.id != -1) {
-                a->text.beginSelection(a->activeText, x, y);
-                return 1;
-            }
-        } else if (action == AMOTION_EVENT_ACTION_MOVE) {
-            if (a->activeText.id != -1) {
-                a->text.updateSelection(a->activeText, x, y);
-                return 1;
-            }
-        } else if (action == AMOTION_EVENT_ACTION_UP || action == AMOTION_EVENT_ACTION_CANCEL) {
-            if (a->activeText.id != -1) {
-                a->text.endSelection(a->activeText);
-                // keep activeText if you want caret to remain focused; or clear it:
-                // a->activeText = {-1};
-                return 1;
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lk(a->touch.mx);
+        InputBatch& b = a->touch.pending;
+        was_empty = b.empty();
+        for (size_t h = 0; h < hist; h++) {
+            const int64_t th = AMotionEvent_getHistoricalEventTime(e, h);
+            for (size_t p = 0; p < n; p++) {
+                b.move(AMotionEvent_getPointerId(e, p), AMotionEvent_getHistoricalX(e, p, h),
+                       AMotionEvent_getHistoricalY(e, p, h), th);
             }
         }
+        switch (action & AMOTION_EVENT_ACTION_MASK) {
+            case AMOTION_EVENT_ACTION_DOWN:
+            case AMOTION_EVENT_ACTION_POINTER_DOWN:
+                b.down(AMotionEvent_getPointerId(e, idx), AMotionEvent_getX(e, idx), AMotionEvent_getY(e, idx), t);
+                break;
+            case AMOTION_EVENT_ACTION_UP:
+            case AMOTION_EVENT_ACTION_POINTER_UP:
+                b.up(AMotionEvent_getPointerId(e, idx), AMotionEvent_getX(e, idx), AMotionEvent_getY(e, idx), t, false);
+                break;
+            case AMOTION_EVENT_ACTION_CANCEL:
+                for (size_t p = 0; p < n; p++) {
+                    b.up(AMotionEvent_getPointerId(e, p), AMotionEvent_getX(e, p), AMotionEvent_getY(e, p), t, true);
+                }
+                break;
+            case AMOTION_EVENT_ACTION_MOVE:
+                for (size_t p = 0; p < n; p++) {
+                    b.move(AMotionEvent_getPointerId(e, p), AMotionEvent_getX(e, p), AMotionEvent_getY(e, p), t);
+                }
+                break;
+            default: // hover, scroll, outside
+                break;
+        }
     }
+    // the render thread takes the batch under the same mutex: only the first
+    // event of a batch has to wake it
+    if (was_empty) wake_render(a);
+}
+// Only forwards: hit testing and selection run on the render thread, which
+// owns the renderers, so every motion/key event counts as consumed here.
+static int32_t handle_input(android_app* app, AInputEvent* event) {
+    App* a = (App*)app->userData;
 
-    if (type == AINPUT_EVENT_TYPE_KEY) {
-        int key = AKeyEvent_getKeyCode(event);
-        int action = AKeyEvent_getAction(event);
-
-        // Handle keyboard here
+    RenderCmd c{};
+    const int type = AInputEvent_getType(event);
+    if (type == AINPUT_EVENT_TYPE_MOTION) {
+        read_motion(a, event);
         return 1;
+    } else if (type == AINPUT_EVENT_TYPE_KEY) {
+        c.kind = RenderCmd::Kind::Key;
+        c.action = AKeyEvent_getAction(event);
+        c.key = AKeyEvent_getKeyCode(event);
+        c.event_ns = AKeyEvent_getEventTime(event);
+    } else {
+        return 0; // not consumed
     }
-
-    return 0; // not consumed
+    if (!a->cmds.push(std::move(c)) && (a->cmds_dropped++ % 64) == 0) {
+        logx::Ef("render queue full: {} events dropped", a->cmds_dropped);
+    }
+    wake_render(a);
+    return 1;
 }
 
 /* ---------------- Entry ---------------- */
@@ -447,27 +1064,18 @@ void android_main(struct android_app* app) {
     app->userData = &a;
     app->onAppCmd = handle_cmd;
     app->onInputEvent = handle_input;
+    a.render_thread = std::thread(render_main, app);
 
+    // events only: frames are paced by the render thread's eglSwapBuffers
     for (;;) {
         int events;
         struct android_poll_source* source;
-
-        int timeout_ms = a.r.initialized ? 0 : -1;
-
-        while (ALooper_pollOnce(timeout_ms, NULL, &events, (void**)&source) >= 0) {
-            if (source) source->process(app, source);
-            if (app->destroyRequested) {
-                if (a.r.initialized) {
-                    destroy_app(&a);
-                }
-                return;
-            }
-            timeout_ms = 0;
+        if (ALooper_pollOnce(-1, NULL, &events, (void**)&source) >= 0 && source) {
+            source->process(app, source);
         }
-
-        if (a.r.initialized) {
-            render(&a);
-            eglSwapBuffers(a.r.display, a.r.surface);
+        if (app->destroyRequested) {
+            stop_render_thread(&a);
+            return;
         }
     }
 }
@@ -0,0 +1,161 @@
+// profiler.cpp
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "logging.hpp"
+static constexpr char NS[] = "Prof";
+using logx = logger::logx<NS>;
+
+static float msBetween(Profiler::Clock::time_point t0, Profiler::Clock::time_point t1) {
+    return std::chrono::duration<float, std::milli>(t1 - t0).count();
+}
+static uint32_t usBetween(Profiler::Clock::time_point t0, Profiler::Clock::time_point t1) {
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+    return (uint32_t)std::max<int64_t>(0, us);
+}
+
+void Profiler::setEnabled(bool on) {
+    m_enabled = on;
+    m_open = false;
+    if (on && m_ring.empty()) m_ring.resize(kFrames);
+}
+void Profiler::beginFrame() {
+    m_open = m_enabled;
+    if (!m_open) return;
+    m_cur = Sample{};
+    m_cur.start = Clock::now();
+}
+void Profiler::endFrame() {
+    if (!m_open) return;
+    m_open = false;
+    m_cur.ms[(int)ProfPhase::Frame] = msBetween(m_cur.start, Clock::now());
+    m_ring[m_next] = m_cur;
+    m_next = (m_next + 1) % kFrames;
+    m_count = std::min(m_count + 1, kFrames);
+}
+void Profiler::add(ProfPhase p, Clock::time_point t0, Clock::time_point t1) {
+    if (!m_open) return;
+    m_cur.ms[(int)p] += msBetween(t0, t1);
+    if (m_cur.eventCount < kEvents) {
+        m_cur.events[m_cur.eventCount++] = Event{p, usBetween(m_cur.start, t0), usBetween(t0, t1)};
+    }
+}
+
+template <class F>
+Profiler::Percentiles Profiler::percentiles(F value) const {
+    Percentiles out;
+    if (!m_count) return out;
+    m_scratch.clear();
+    for (size_t i = 0; i < m_count; i++) m_scratch.push_back(value(m_ring[i]));
+    std::sort(m_scratch.begin(), m_scratch.end());
+    // nearest rank
+    auto at = [&](float q) { return m_scratch[std::min(m_count - 1, (size_t)(q * (float)m_count))]; };
+    out.p50 = at(0.50f);
+    out.p95 = at(0.95f);
+    out.p99 = at(0.99f);
+    out.max = m_scratch.back();
+    return out;
+}
+Profiler::Percentiles Profiler::phase(ProfPhase p) const {
+    return percentiles([p](const Sample& s) { return s.ms[(int)p]; });
+}
+Profiler::Percentiles Profiler::counter(ProfCounter c) const {
+    return percentiles([c](const Sample& s) { return (float)s.counters[(int)c]; });
+}
+std::vector<uint32_t> Profiler::histogram(ProfPhase p, float bucketMs, size_t buckets) const {
+    std::vector<uint32_t> out(buckets, 0);
+    if (!buckets || bucketMs <= 0.0f) return out;
+    for (size_t i = 0; i < m_count; i++) {
+        const size_t b = (size_t)(m_ring[i].ms[(int)p] / bucketMs);
+        out[std::min(b, buckets - 1)]++;
+    }
+    return out;
+}
+
+const char* Profiler::name(ProfPhase p) {
+    switch (p) {
+        case ProfPhase::Frame:      return "Frame";
+        case ProfPhase::Input:      return "Input";
+        case ProfPhase::Load:       return "Load";
+        case ProfPhase::TextShape:  return "TextShape";
+        case ProfPhase::TextUpload: return "TextUpload";
+        case ProfPhase::UiUpload:   return "UiUpload";
+        case ProfPhase::Draw:       return "Draw";
+        case ProfPhase::Swap:       return "Swap";
+        default:                    return "?";
+    }
+}
+const char* Profiler::name(ProfCounter c) {
+    switch (c) {
+        case ProfCounter::DrawCalls:        return "DrawCalls";
+        case ProfCounter::BytesUploaded:    return "BytesUploaded";
+        case ProfCounter::GlyphsRasterized: return "GlyphsRasterized";
+        default:                            return "?";
+    }
+}
+
+void Profiler::logSummary() const {
+    if (!m_count) return;
+    logx::If("{} frames (ms p50/p95/p99/max):", m_count);
+    for (int i = 0; i < (int)ProfPhase::Count; i++) {
+        const Percentiles q = phase((ProfPhase)i);
+        if (q.max <= 0.0f) continue;
+        logx::If("  {:<10} {:.2f} / {:.2f} / {:.2f} / {:.2f}", name((ProfPhase)i), q.p50, q.p95, q.p99, q.max);
+    }
+    for (int i = 0; i < (int)ProfCounter::Count; i++) {
+        const Percentiles q = counter((ProfCounter)i);
+        logx::If("  {:<16} p50 {:.0f} p95 {:.0f} max {:.0f} per frame", name((ProfCounter)i), q.p50, q.p95, q.max);
+    }
+}
+
+// ts/dur in microseconds from the oldest frame kept; one pid/tid (render thread)
+bool Profiler::writeChromeTrace(const std::string& path) const {
+    if (!m_count) return false;
+    const size_t first = (m_count < kFrames) ? 0 : m_next;
+    const Clock::time_point t0 = m_ring[first].start;
+
+    // write-then-rename, like the other caches in internalDataPath
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out.is_open()) return false;
+        char buf[256];
+        bool comma = false;
+        auto emit = [&](int n) {
+            if (n <= 0) return;
+            if (comma) out << ",\n";
+            out.write(buf, std::min<int>(n, (int)sizeof(buf) - 1));
+            comma = true;
+        };
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        for (size_t k = 0; k < m_count; k++) {
+            const Sample& s = m_ring[(first + k) % kFrames];
+            const uint32_t ts = usBetween(t0, s.start);
+            emit(std::snprintf(buf, sizeof(buf),
+                               "{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%u,\"dur\":%u}",
+                               ts, (uint32_t)(s.ms[(int)ProfPhase::Frame] * 1000.0f)));
+            for (uint8_t e = 0; e < s.eventCount; e++) {
+                const Event& ev = s.events[e];
+                emit(std::snprintf(buf, sizeof(buf),
+                                   "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%u,\"dur\":%u}",
+                                   name(ev.phase), ts + ev.start_us, ev.dur_us));
+            }
+            for (int c = 0; c < (int)ProfCounter::Count; c++) {
+                emit(std::snprintf(buf, sizeof(buf),
+                                   "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%u,\"args\":{\"value\":%llu}}",
+                                   name((ProfCounter)c), ts, (unsigned long long)s.counters[c]));
+            }
+        }
+        out << "\n]}\n";
+        if (!out) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) return false;
+    logx::If("wrote {} frames to {}", m_count, path);
+    return true;
+}
@@ -0,0 +1,116 @@
+// profiler.hpp - per-frame CPU phase timers, counters, percentiles and Chrome trace dump
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Phase time is the sum of all scopes of that phase in a frame; Frame is
+// beginFrame() to endFrame().
+enum class ProfPhase : uint8_t {
+    Frame,
+    Input,      // queued commands/input applied
+    Load,       // GL half of window-init loading
+    TextShape,  // shaping + glyph rasterization (TextShaper::buildMeshes)
+    TextUpload, // label meshes + glyph atlas
+    UiUpload,   // UiRenderer instance + state/transform uploads
+    Draw,       // DrawList::flush
+    Swap,       // eglSwapBuffers*, includes waiting for a buffer
+    Count
+};
+enum class ProfCounter : uint8_t {
+    DrawCalls,
+    BytesUploaded,
+    GlyphsRasterized,
+    Count
+};
+
+// Ring of the last kFrames frame samples; owned and used by the render
+// thread only. Disabled (the default) it keeps no storage and a ProfScope
+// costs one branch: no clock reads.
+class Profiler {
+public:
+    static constexpr size_t kFrames = 512;
+    static constexpr size_t kEvents = 24; // scopes kept per frame for the trace; times still add up past it
+
+    using Clock = std::chrono::steady_clock;
+
+    void setEnabled(bool on);
+    bool enabled() const { return m_enabled; }
+
+    // Only frames closed with endFrame() are kept; dropFrame() discards one
+    // that turned out to draw nothing.
+    void beginFrame();
+    void endFrame();
+    void dropFrame() { m_open = false; }
+
+    void add(ProfPhase p, Clock::time_point t0, Clock::time_point t1);
+    void count(ProfCounter c, uint64_t n) {
+        if (m_open) m_cur.counters[(int)c] += n;
+    }
+
+    struct Percentiles {
+        float p50 = 0.0f, p95 = 0.0f, p99 = 0.0f, max = 0.0f;
+    };
+    // over the frames in the ring; ms for phases, per-frame values for counters
+    Percentiles phase(ProfPhase p) const;
+    Percentiles counter(ProfCounter c) const;
+    // frames per bucket of bucketMs for phase p (Frame = frame time); the
+    // last bucket also takes everything longer
+    std::vector<uint32_t> histogram(ProfPhase p, float bucketMs, size_t buckets) const;
+    size_t frames() const { return m_count; }
+
+    static const char* name(ProfPhase p);
+    static const char* name(ProfCounter c);
+
+    // one line per phase plus counters
+    void logSummary() const;
+    // Chrome trace event JSON (chrome://tracing, Perfetto): a complete event
+    // per frame and per scope, counter tracks per frame.
+    bool writeChromeTrace(const std::string& path) const;
+
+private:
+    struct Event {
+        ProfPhase phase;
+        uint32_t start_us; // from frame start
+        uint32_t dur_us;
+    };
+    struct Sample {
+        Clock::time_point start{};
+        float ms[(int)ProfPhase::Count] = {};
+        uint64_t counters[(int)ProfCounter::Count] = {};
+        Event events[kEvents];
+        uint8_t eventCount = 0;
+    };
+    template <class F> Percentiles percentiles(F value) const;
+
+    bool m_enabled = false;
+    bool m_open = false;
+    Sample m_cur;
+    std::vector<Sample> m_ring; // kFrames once enabled
+    size_t m_next = 0;          // slot the next endFrame() writes
+    size_t m_count = 0;
+    mutable std::vector<float> m_scratch;
+};
+
+// Times one phase until the end of the scope; a null or disabled profiler
+// (or one between frames) records nothing.
+class ProfScope {
+public:
+    ProfScope(Profiler* prof, ProfPhase phase)
+        : m_prof(prof && prof->enabled() ? prof : nullptr), m_phase(phase) {
+        if (m_prof) m_t0 = Profiler::Clock::now();
+    }
+    ~ProfScope() {
+        if (m_prof) m_prof->add(m_phase, m_t0, Profiler::Clock::now());
+    }
+    ProfScope(const ProfScope&) = delete;
+    ProfScope& operator=(const ProfScope&) = delete;
+
+private:
+    Profiler* m_prof;
+    ProfPhase m_phase;
+    Profiler::Clock::time_point m_t0{};
+};
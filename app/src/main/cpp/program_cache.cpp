@@ -0,0 +1,101 @@
+// program_cache.cpp
+#include "program_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "logging.hpp"
+static constexpr char NS[] = "ProgCache";
+using logx = logger::logx<NS>;
+
+namespace {
+struct Header {
+    char magic[4];       // "PBC1"
+    uint32_t format;     // binaryFormat from glGetProgramBinary
+    uint64_t deviceHash;
+    uint64_t srcHash;    // the file name is only 64 bits of it; guards against a stray rename
+    uint64_t size;
+};
+constexpr char kMagic[4] = {'P', 'B', 'C', '1'};
+
+uint64_t fnv1a(uint64_t h, std::string_view s) {
+    for (unsigned char c : s) { h ^= c; h *= 0x100000001b3ull; }
+    return h;
+}
+constexpr uint64_t kFnvBasis = 0xcbf29ce484222325ull;
+}
+
+std::string ProgramCache::pathFor(uint64_t srcHash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/prog_%016llx.bin", (unsigned long long)srcHash);
+    return m_dir + name;
+}
+
+uint64_t ProgramCache::srcHash(std::string_view vs, std::string_view fs) {
+    if (!m_deviceHash) m_deviceHash = fnv1a(kFnvBasis, m_gl.deviceId()) | 1;
+    // the separator keeps ("ab", "c") and ("a", "bc") apart
+    return fnv1a(fnv1a(fnv1a(kFnvBasis, vs), std::string_view("\0", 1)), fs);
+}
+
+uint32_t ProgramCache::load(std::string_view vs, std::string_view fs) {
+    if (m_dir.empty() || !m_gl.binarySupported()) return 0;
+
+    const uint64_t hash = srcHash(vs, fs);
+    const std::string path = pathFor(hash);
+    std::ifstream in(path, std::ios::binary);
+    Header h{};
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) ||
+        std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 ||
+        h.deviceHash != m_deviceHash || h.srcHash != hash || h.size == 0 || h.size >= (64u << 20)) {
+        m_stats.misses++;
+        return 0;
+    }
+    std::vector<uint8_t> bin((size_t)h.size);
+    if (!in.read(reinterpret_cast<char*>(bin.data()), (std::streamsize)bin.size())) {
+        m_stats.misses++;
+        return 0;
+    }
+    if (const uint32_t prog = m_gl.loadBinary(h.format, bin.data(), bin.size())) {
+        m_stats.hits++;
+        return prog;
+    }
+    // e.g. a driver change GL_RENDERER/GL_VERSION didn't reflect; store() overwrites it
+    m_stats.rejected++;
+    logx::If("binary rejected, relinking: {}", path);
+    return 0;
+}
+
+bool ProgramCache::store(std::string_view vs, std::string_view fs, uint32_t prog) {
+    if (m_dir.empty() || !prog || !m_gl.binarySupported()) return false;
+    const uint64_t hash = srcHash(vs, fs);
+    const std::string path = pathFor(hash);
+    if (!write(path, hash, prog)) {
+        logx::Ef("could not store {}", path);
+        return false;
+    }
+    return true;
+}
+
+bool ProgramCache::write(const std::string& path, uint64_t srcHash, uint32_t prog) {
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    std::vector<uint8_t> bin;
+    if (!m_gl.getBinary(prog, h.format, bin) || bin.empty()) return false;
+    h.deviceHash = m_deviceHash;
+    h.srcHash = srcHash;
+    h.size = bin.size();
+
+    // write-then-rename: a crash mid-write never leaves a plausible partial binary
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(bin.data()), (std::streamsize)bin.size());
+        if (!out) return false;
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) return false;
+    m_stats.stored++;
+    return true;
+}
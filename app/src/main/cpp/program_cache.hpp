@@ -0,0 +1,62 @@
+// program_cache.hpp - glGetProgramBinary cache for UiRenderer/TextRenderer programs
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The GL calls the cache makes, so the cache logic builds and runs without a
+// context (test/program_cache_test.cpp fakes it on the host). Names/enums as uint32_t.
+class ProgramGl {
+public:
+    virtual ~ProgramGl() = default;
+    // GL_RENDERER + GL_VERSION; a driver update invalidates every binary
+    virtual std::string deviceId() const = 0;
+    // GL_NUM_PROGRAM_BINARY_FORMATS > 0
+    virtual bool binarySupported() const = 0;
+    // glProgramBinary into a new program; 0 if the driver rejects it (link fails)
+    virtual uint32_t loadBinary(uint32_t format, const void* data, size_t size) = 0;
+    virtual bool getBinary(uint32_t prog, uint32_t& format, std::vector<uint8_t>& out) = 0;
+};
+
+// GLES 3.0 implementation; needs the current context.
+class GlesProgramGl : public ProgramGl {
+public:
+    std::string deviceId() const override;
+    bool binarySupported() const override;
+    uint32_t loadBinary(uint32_t format, const void* data, size_t size) override;
+    bool getBinary(uint32_t prog, uint32_t& format, std::vector<uint8_t>& out) override;
+};
+
+// One file per (vs, fs) source pair in dir, named by the source hash; the
+// header carries the device hash, so a driver update rewrites the same file
+// rather than leaving stale ones behind. ShaderLibrary compiles on a miss
+// and stores the result for the next start.
+class ProgramCache {
+public:
+    ProgramCache(ProgramGl& gl, std::string dir) : m_gl(gl), m_dir(std::move(dir)) {}
+
+    // 0 on a miss or a rejected binary: compile, and store() once linked
+    uint32_t load(std::string_view vs, std::string_view fs);
+    bool store(std::string_view vs, std::string_view fs, uint32_t prog);
+
+    struct Stats {
+        uint32_t hits = 0;     // loaded from a binary
+        uint32_t misses = 0;   // no (matching) file
+        uint32_t rejected = 0; // file matched, driver refused it
+        uint32_t stored = 0;
+    };
+    const Stats& stats() const { return m_stats; }
+
+private:
+    uint64_t srcHash(std::string_view vs, std::string_view fs);
+    std::string pathFor(uint64_t srcHash) const;
+    bool write(const std::string& path, uint64_t srcHash, uint32_t prog);
+
+    ProgramGl& m_gl;
+    std::string m_dir;
+    uint64_t m_deviceHash = 0; // 0 = not queried yet
+    Stats m_stats;
+};
@@ -0,0 +1,39 @@
+// program_cache_gl.cpp - GLES side of ProgramCache
+#include "program_cache.hpp"
+
+#include <GLES3/gl3.h>
+
+std::string GlesProgramGl::deviceId() const {
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version  = (const char*)glGetString(GL_VERSION);
+    return std::string{renderer ? renderer : ""} + "\n" + (version ? version : "");
+}
+bool GlesProgramGl::binarySupported() const {
+    GLint n = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n);
+    return n > 0;
+}
+uint32_t GlesProgramGl::loadBinary(uint32_t format, const void* data, size_t size) {
+    GLuint p = glCreateProgram();
+    glProgramBinary(p, (GLenum)format, data, (GLsizei)size);
+    GLint ok = 0;
+    glGetProgramiv(p, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        glDeleteProgram(p);
+        return 0;
+    }
+    return p;
+}
+bool GlesProgramGl::getBinary(uint32_t prog, uint32_t& format, std::vector<uint8_t>& out) {
+    GLint len = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &len);
+    if (len <= 0) return false;
+    out.resize((size_t)len);
+    GLsizei written = 0;
+    GLenum fmt = 0;
+    glGetProgramBinary(prog, len, &written, &fmt, out.data());
+    if (written <= 0) return false;
+    out.resize((size_t)written);
+    format = (uint32_t)fmt;
+    return true;
+}
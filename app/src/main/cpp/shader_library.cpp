@@ -0,0 +1,202 @@
+// shader_library.cpp
+#include "shader_library.hpp"
+
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+#include "program_cache.hpp"
+
+#include "logging.hpp"
+static constexpr char NS[] = "Shaders";
+using logx = logger::logx<NS>;
+
+static void logShader(GLuint s, const char* label) {
+    GLint len = 0;
+    glGetShaderiv(s, GL_INFO_LOG_LENGTH, &len);
+    if (len > 1) {
+        std::vector<char> buf((size_t)len);
+        glGetShaderInfoLog(s, len, nullptr, buf.data());
+        logx::Ef("{} shader log:\n{}", label, buf.data());
+    }
+}
+static void logProgram(GLuint p) {
+    GLint len = 0;
+    glGetProgramiv(p, GL_INFO_LOG_LENGTH, &len);
+    if (len > 1) {
+        std::vector<char> buf((size_t)len);
+        glGetProgramInfoLog(p, len, nullptr, buf.data());
+        logx::Ef("program log:\n{}", buf.data());
+    }
+}
+static GLuint compileShader(GLenum type, std::string_view src) {
+    GLuint s = glCreateShader(type);
+    const char* str = src.data();
+    const GLint len = (GLint)src.size();
+    glShaderSource(s, 1, &str, &len);
+    glCompileShader(s);
+    // status is read in finish(), so the driver may still be compiling
+    return s;
+}
+static uint64_t fnv1a(uint64_t h, std::string_view s) {
+    for (unsigned char c : s) { h ^= c; h *= 0x100000001b3ull; }
+    return h;
+}
+
+// Swaps the source's own #version line for `version` and injects `defines`
+// (one "#define X 1" per entry) right after it.
+std::string ShaderLibrary::withHeader(std::string_view src, const char* version,
+                                      const std::vector<const char*>& defines) {
+    std::string_view body = src;
+    std::string out;
+    if (body.starts_with("#version")) {
+        const size_t nl = body.find('\n');
+        const std::string_view own = body.substr(0, nl);
+        body = (nl == std::string_view::npos) ? std::string_view{} : body.substr(nl + 1);
+        if (!version) out.append(own).append("\n");
+    }
+    if (version) out = std::string{"#version "} + version + "\n";
+    for (const char* d : defines) out += std::string{"#define "} + d + " 1\n";
+    out += body;
+    return out;
+}
+
+void ShaderLibrary::initCaps() {
+    m_capsKnown = true;
+    GLint n = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+    for (GLint i = 0; i < n && !m_parallel; i++) {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        m_parallel = ext && std::strcmp(ext, "GL_KHR_parallel_shader_compile") == 0;
+    }
+    if (!m_parallel) return;
+    // 0xFFFFFFFF = as many threads as the implementation likes
+    auto maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)eglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    if (maxThreads) maxThreads(0xFFFFFFFFu);
+    logx::I("KHR_parallel_shader_compile available");
+}
+
+ShaderLibrary::Entry* ShaderLibrary::get(Id id) {
+    if (id < 0 || id >= (Id)m_entries.size() || !m_entries[id].refs) return nullptr;
+    return &m_entries[id];
+}
+
+ShaderLibrary::Id ShaderLibrary::request(std::string_view vs, std::string_view fs,
+                                         const char* version, const std::vector<const char*>& defines) {
+    if (vs.empty() || fs.empty()) return -1;
+    if (!m_capsKnown) initCaps();
+
+    std::string vsrc = withHeader(vs, version, defines);
+    std::string fsrc = withHeader(fs, version, defines);
+    const uint64_t hash = fnv1a(fnv1a(fnv1a(0xcbf29ce484222325ull, vsrc), std::string_view("\0", 1)), fsrc);
+    auto [lo, hi] = m_byHash.equal_range(hash);
+    for (auto it = lo; it != hi; ++it) {
+        Entry& e = m_entries[it->second];
+        if (e.vs == vsrc && e.fs == fsrc) {
+            e.refs++;
+            return it->second;
+        }
+    }
+
+    Id id;
+    if (!m_free.empty()) { id = m_free.back(); m_free.pop_back(); }
+    else { id = (Id)m_entries.size(); m_entries.emplace_back(); }
+    Entry& e = m_entries[id];
+    e = Entry{};
+    e.vs = std::move(vsrc);
+    e.fs = std::move(fsrc);
+    e.hash = hash;
+    e.refs = 1;
+    m_byHash.emplace(hash, id);
+
+    if (m_cache) {
+        if (const GLuint p = m_cache->load(e.vs, e.fs)) {
+            e.prog = p;
+            e.state = State::Linked;
+            return id;
+        }
+    }
+    e.vsh = compileShader(GL_VERTEX_SHADER, e.vs);
+    e.fsh = compileShader(GL_FRAGMENT_SHADER, e.fs);
+    e.prog = glCreateProgram();
+    glAttachShader(e.prog, e.vsh);
+    glAttachShader(e.prog, e.fsh);
+    // lets ProgramCache fetch the binary afterwards
+    glProgramParameteri(e.prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(e.prog);
+    return id;
+}
+
+bool ShaderLibrary::ready(Id id) const {
+    if (id < 0 || id >= (Id)m_entries.size()) return true;
+    const Entry& e = m_entries[id];
+    if (e.state != State::Pending || !m_parallel) return true;
+    GLint done = GL_FALSE;
+    glGetProgramiv(e.prog, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+void ShaderLibrary::finish(Entry& e) {
+    GLint ok = 0;
+    glGetProgramiv(e.prog, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        // the link log is often just "shader not compiled"; show why
+        GLint vok = 0, fok = 0;
+        glGetShaderiv(e.vsh, GL_COMPILE_STATUS, &vok);
+        glGetShaderiv(e.fsh, GL_COMPILE_STATUS, &fok);
+        if (!vok) logShader(e.vsh, "VERT");
+        if (!fok) logShader(e.fsh, "FRAG");
+        logProgram(e.prog);
+        glDeleteProgram(e.prog);
+        e.prog = 0;
+    }
+    glDeleteShader(e.vsh);
+    glDeleteShader(e.fsh);
+    e.vsh = e.fsh = 0;
+    e.state = ok ? State::Linked : State::Failed;
+    if (ok && m_cache) m_cache->store(e.vs, e.fs, e.prog);
+}
+
+GLuint ShaderLibrary::program(Id id) {
+    Entry* e = get(id);
+    if (!e) return 0;
+    if (e->state == State::Pending) finish(*e);
+    return e->prog;
+}
+
+void ShaderLibrary::setMvp(Id id, GLint loc, const float* mvp4x4) {
+    Entry* e = get(id);
+    if (!e || std::memcmp(e->mvp, mvp4x4, sizeof(e->mvp)) == 0) return;
+    std::memcpy(e->mvp, mvp4x4, sizeof(e->mvp));
+    glUniformMatrix4fv(loc, 1, GL_FALSE, e->mvp);
+}
+
+void ShaderLibrary::release(Id id) {
+    Entry* e = get(id);
+    if (!e || --e->refs) return;
+    if (e->vsh) glDeleteShader(e->vsh);
+    if (e->fsh) glDeleteShader(e->fsh);
+    if (e->prog) glDeleteProgram(e->prog);
+    auto [lo, hi] = m_byHash.equal_range(e->hash);
+    for (auto it = lo; it != hi; ++it) {
+        if (it->second == id) { m_byHash.erase(it); break; }
+    }
+    *e = Entry{};
+    m_free.push_back(id);
+}
+
+void ShaderLibrary::shutdown() {
+    for (Entry& e : m_entries) {
+        if (!e.refs) continue;
+        if (e.vsh) glDeleteShader(e.vsh);
+        if (e.fsh) glDeleteShader(e.fsh);
+        if (e.prog) glDeleteProgram(e.prog);
+    }
+    m_entries.clear();
+    m_free.clear();
+    m_byHash.clear();
+    // a new context may have other extensions
+    m_capsKnown = false;
+    m_parallel = false;
+}
@@ -0,0 +1,74 @@
+// shader_library.hpp - shared, deduplicated GL programs with deferred link checks
+#pragma once
+
+#include <GLES3/gl3.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class ProgramCache;
+
+/*One per GL context, shared by every renderer drawing into it.
+
+request() builds the final source (#version + "#define X 1" lines + body),
+returns the existing program for identical source, and otherwise starts the
+compile + link without reading any status back. Requesting everything first
+and calling program() later lets the driver compile them all at once
+(KHR_parallel_shader_compile, or its own deferred compile); ready() polls
+without blocking where the extension exists.*/
+class ShaderLibrary {
+public:
+    using Id = int32_t; // -1 = none
+
+    explicit ShaderLibrary(ProgramCache* cache = nullptr) : m_cache(cache) {}
+    ShaderLibrary(const ShaderLibrary&) = delete;
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+    // version: replaces the source's #version line (nullptr keeps it)
+    Id request(std::string_view vs, std::string_view fs,
+               const char* version = nullptr, const std::vector<const char*>& defines = {});
+    // true once program() won't block; always true without the extension
+    bool ready(Id id) const;
+    // Finishes the link; 0 (logged once) if it failed.
+    GLuint program(Id id);
+    // Deletes the program when its last requester lets go.
+    void release(Id id);
+
+    // Uploads a mat4 unless it is what any user of this program last set there;
+    // programs are shared, so a per-renderer cache would go stale.
+    void setMvp(Id id, GLint loc, const float* mvp4x4);
+
+    // Deletes everything still held; the context must be current.
+    void shutdown();
+
+    bool parallel() const { return m_parallel; }
+
+    static std::string withHeader(std::string_view src, const char* version,
+                                  const std::vector<const char*>& defines);
+
+private:
+    enum class State : uint8_t { Pending, Linked, Failed };
+    struct Entry {
+        std::string vs, fs;
+        uint64_t hash = 0;
+        GLuint prog = 0;
+        GLuint vsh = 0, fsh = 0; // until the link is checked
+        State state = State::Pending;
+        uint32_t refs = 0;
+        float mvp[16] = {};
+    };
+    void initCaps();
+    Entry* get(Id id);
+    void finish(Entry& e);
+
+    ProgramCache* m_cache = nullptr;
+    std::vector<Entry> m_entries;
+    std::vector<Id> m_free;
+    std::unordered_multimap<uint64_t, Id> m_byHash;
+    bool m_capsKnown = false;
+    bool m_parallel = false;
+};
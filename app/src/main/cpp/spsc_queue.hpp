@@ -0,0 +1,51 @@
+// spsc_queue.hpp - bounded lock-free single-producer/single-consumer ring
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// One thread push()es, one other thread pop()s; neither ever blocks or locks.
+// N is a power of two; one slot is never used, so N - 1 items fit. Slots are
+// moved from and left in their moved-from state until overwritten.
+template <class T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+public:
+    // false (item untouched) when full
+    bool push(T&& item) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t next = (head + 1) & (N - 1);
+        if (next == m_tailCache) {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (next == m_tailCache) return false;
+        }
+        m_slots[head] = std::move(item);
+        m_head.store(next, std::memory_order_release);
+        return true;
+    }
+    bool pop(T& out) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_headCache) {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail == m_headCache) return false;
+        }
+        out = std::move(m_slots[tail]);
+        m_tail.store((tail + 1) & (N - 1), std::memory_order_release);
+        return true;
+    }
+    // approximate from either side
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    // producer and consumer indices on their own cache lines; each side keeps a
+    // stale copy of the other's so the shared line is only read when it looks full/empty
+    alignas(64) std::atomic<size_t> m_head{0}; // written by the producer
+    size_t m_tailCache = 0;                    // producer's view of m_tail
+    alignas(64) std::atomic<size_t> m_tail{0}; // written by the consumer
+    size_t m_headCache = 0;                    // consumer's view of m_head
+    alignas(64) std::array<T, N> m_slots{};
+};
@@ -2,6 +2,7 @@
 #include <GLES3/gl3.h>
 
 #include "text_renderer.hpp"
+#include "utf8.hpp"
 
 #include <cstring>
 #include <cstddef>
@@ -13,106 +14,13 @@
 static constexpr char NS[] = "TextR";
 using logx = logger::logx<NS>;
 
-static void logShader(GLuint s, const char* label) {
-    GLint len = 0;
-    glGetShaderiv(s, GL_INFO_LOG_LENGTH, &len);
-    if (len > 1) {
-        std::vector<char> buf((size_t)len);
-        glGetShaderInfoLog(s, len, nullptr, buf.data());
-        logx::Ef("{} Text shader log:\n{}", label, buf.data());
-    }
-}
-static void logProgram(GLuint p) {
-    GLint len = 0;
-    glGetProgramiv(p, GL_INFO_LOG_LENGTH, &len);
-    if (len > 1) {
-        std::vector<char> buf((size_t)len);
-        glGetProgramInfoLog(p, len, nullptr, buf.data());
-        logx::Ef("Text program log:\n{}", buf.data());
-    }
-}
-
-static inline FT_Fixed f2dot16(float v) {
-    // FreeType uses 16.16 fixed-point for variation coordinates
-    // Round to nearest
-    double x = (double)v * 65536.0;
-    if (x >= 0.0) x += 0.5;
-    else         x -= 0.5;
-    return (FT_Fixed)x;
-}
-static std::vector<uint32_t> buildUtf8Index(const char* utf8) {
-    std::vector<uint32_t> out;
-    for (uint32_t i = 0; utf8[i]; ) {
-        out.push_back(i);
-        unsigned char c = (unsigned char)utf8[i];
-        i += (c < 0x80) ? 1 :
-             ((c & 0xE0) == 0xC0) ? 2 :
-             ((c & 0xF0) == 0xE0) ? 3 : 4;
-    }
-    out.push_back((uint32_t)strlen(utf8));
-    return out;
-}
-static int utf8_codepoint_count_from_index(const std::vector<uint32_t>& cpByteOffsets) {
-    return (cpByteOffsets.size() >= 1) ? (int)cpByteOffsets.size() - 1 : 0;
-}
-static int codepointIndexFromCluster(uint32_t clusterByte, const std::vector<uint32_t>& cpByteOffsets) {
-    // find greatest i where cpByteOffsets[i] <= clusterByte
-    auto it = std::upper_bound(cpByteOffsets.begin(), cpByteOffsets.end(), clusterByte);
-    if (it == cpByteOffsets.begin()) return 0;
-    return (int)std::distance(cpByteOffsets.begin(), it - 1);
-}
-static uint32_t utf8DecodeOne(const char* s, int& advBytes) {
-    const unsigned char c0 = (unsigned char)s[0];
-    if (c0 < 0x80) { advBytes = 1; return c0; }
-    if ((c0 & 0xE0) == 0xC0) { advBytes = 2; return ((c0 & 0x1F) << 6) | (s[1] & 0x3F); }
-    if ((c0 & 0xF0) == 0xE0) { advBytes = 3; return ((c0 & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F); }
-    advBytes = 4;
-    return ((c0 & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
-}
 TextRenderer::GlyphMetrics TextRenderer::measureCodepoint(uint32_t cp) const {
-    GlyphMetrics gm{};
-
-    if (!m_face) return gm;
-
-    const FT_UInt gid = FT_Get_Char_Index(m_face, cp);
-    gm.gid = gid;
-    if (gid == 0) return gm; // missing glyph
-
-    // Load metrics (no render needed). You can keep your hinting policy here.
-    if (FT_Load_Glyph(m_face, gid, FT_LOAD_DEFAULT | FT_LOAD_NO_BITMAP) != 0) return gm;
-
-    const FT_GlyphSlot slot = m_face->glyph;
-
-    // Advance in 26.6 fixed-point
-    gm.advanceX = (float)slot->advance.x / 64.0f;
-    gm.advanceY = (float)slot->advance.y / 64.0f;
-
-    // If you want bitmap metrics exactly like your atlas rendering uses:
-    // do a render load (costly but accurate for bitmap box)
-    if (FT_Load_Glyph(m_face, gid, FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) == 0) {
-        gm.bmpW = (int)slot->bitmap.width;
-        gm.bmpH = (int)slot->bitmap.rows;
-        gm.bearingX = slot->bitmap_left;
-        gm.bearingY = slot->bitmap_top;
-    }
-
-    // Outline bbox (works when outline exists); in font units -> convert to pixels.
-    if (slot->format == FT_GLYPH_FORMAT_OUTLINE) {
-        FT_BBox bb;
-        FT_Outline_Get_CBox(&slot->outline, &bb); // 26.6 units
-        gm.bboxXMin = (float)bb.xMin / 64.0f;
-        gm.bboxYMin = (float)bb.yMin / 64.0f;
-        gm.bboxXMax = (float)bb.xMax / 64.0f;
-        gm.bboxYMax = (float)bb.yMax / 64.0f;
-    }
-
-    gm.valid = true;
-    return gm;
+    return m_shaper.measureCodepoint(cp);
 }
 TextRenderer::GlyphMetrics TextRenderer::measureUtf8Glyph(const char* utf8, int byteOffset) const {
     if (!utf8) return GlyphMetrics{};
     int adv = 0;
-    const uint32_t cp = utf8DecodeOne(utf8 + byteOffset, adv);
+    const uint32_t cp = utf8::decodeOne(utf8 + byteOffset, adv);
     return measureCodepoint(cp);
 }
 int TextRenderer::caretIndexFromLocalX(const TextObj& t, float localX) {
@@ -155,26 +63,29 @@ static void setupTextVao(GLuint vao, GLuint vbo) {
 
 TextRenderer::~TextRenderer() { 
     shutdown();
-    if (m_ft) FT_Done_FreeType(m_ft);
-    m_ft = nullptr;
 }
 
 bool TextRenderer::init(const Assets::Manager& am, const std::string& font_name, int pixelSize, int atlasW, int atlasH) {
     shutdown();
     
-    m_font = am.get_font(font_name);
-    if (m_font.bytes.empty()) return false;
+    Assets::Font font = am.get_font(font_name);
+    if (font.empty()) return false;
     
     // 1) shader program
-    if (!initProgram(am)) { return false; }
-
-    // 2) font + atlas
-    if (!initFont(pixelSize)) { destroyProgram(); return false; }
-    if (!initAtlas(atlasW, atlasH)) { destroyFont(); destroyProgram(); return false; }
+    if (!initGl(am.view("shaders/text.vert"), am.view("shaders/text.frag"))) { return false; }
 
-    std::memset(m_glyphs, 0, sizeof(m_glyphs));
+    // 2) font + atlas (CPU side; texture is created on first update())
+    if (!initFont(std::move(font), pixelSize, atlasW, atlasH)) { destroyProgram(); return false; }
     return true;
 }
+bool TextRenderer::initFont(Assets::Font&& font, int pixelSize, int atlasW, int atlasH) {
+    if (font.empty()) return false;
+    return m_shaper.init(std::move(font), pixelSize, atlasW, atlasH);
+}
+bool TextRenderer::initGl(const Assets::AssetView& vert, const Assets::AssetView& frag) {
+    destroyProgram();
+    return initProgram(vert, frag);
+}
 void TextRenderer::shutdown() {
     // Text VBOs
     for (auto& t : m_items) {
@@ -187,209 +98,72 @@ void TextRenderer::shutdown() {
 
     // Atlas + font
     destroyAtlas();
-    destroyFont();
-    std::memset(m_glyphs, 0, sizeof(m_glyphs));
+    m_shaper.shutdown();
 
     // Program last (safe either way, but keep consistent)
     destroyProgram();
 }
 
 /* ---------------- Program ---------------- */
-GLuint TextRenderer::compileShader(GLenum type, const char* src) {
-    GLuint s = glCreateShader(type);
-    glShaderSource(s, 1, &src, nullptr);
-    glCompileShader(s);
-
-    GLint ok = 0;
-    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
-    if (!ok) {
-        logShader(s, (type == GL_VERTEX_SHADER) ? "VERT" : "FRAG");
-        glDeleteShader(s);
-        return 0;
-    }
-    return s;
-}
-GLuint TextRenderer::linkProgram(const char* vs, const char* fs) {
-    GLuint v = compileShader(GL_VERTEX_SHADER, vs);
-    GLuint f = compileShader(GL_FRAGMENT_SHADER, fs);
-    if (!v || !f) {
-        if (v) glDeleteShader(v);
-        if (f) glDeleteShader(f);
-        return 0;
-    }
-
-    GLuint p = glCreateProgram();
-    glAttachShader(p, v);
-    glAttachShader(p, f);
-
-    glLinkProgram(p);
-
-    glDeleteShader(v);
-    glDeleteShader(f);
-
-    GLint ok = 0;
-    glGetProgramiv(p, GL_LINK_STATUS, &ok);
-    if (!ok) {
-        logProgram(p);
-        glDeleteProgram(p);
-        return 0;
-    }
-    logx::I("linkProgram done");
-    return p;
-}
-bool TextRenderer::initProgram(const Assets::Manager& am) {
-    std::vector<char> vs = am.read("shaders/text.vert");
-    std::vector<char> fs = am.read("shaders/text.frag");
+bool TextRenderer::initProgram(const Assets::AssetView& vs, const Assets::AssetView& fs) {
     if (vs.empty() || fs.empty()) {
         logx::E("failed reading text shaders from storage");
         return false;
     }
-    
-    m_prog = linkProgram(reinterpret_cast<char*>(vs.data()), reinterpret_cast<char*>(fs.data()));
-    if (!m_prog) return false;
+    if (!m_shaders) {
+        m_ownShaders = std::make_unique<ShaderLibrary>();
+        m_shaders = m_ownShaders.get();
+    }
+    // the library may still be compiling; resolveProgram() waits at first use
+    std::vector<const char*> defines;
+    if (m_srgbTarget) defines.push_back("TEXT_LINEAR_COLOR");
+    m_progId = m_shaders->request(vs.str(), fs.str(), nullptr, defines);
+    return m_progId >= 0;
+}
+bool TextRenderer::resolveProgram() {
+    if (m_prog) return true;
+    if (m_progId < 0) return false;
+    m_prog = m_shaders->program(m_progId);
+    if (!m_prog) {
+        logx::E("failed linking text program");
+        m_shaders->release(m_progId);
+        m_progId = -1;
+        return false;
+    }
 
     m_uMVP       = glGetUniformLocation(m_prog, "uMVP");
     m_uTex       = glGetUniformLocation(m_prog, "uTex");
     //m_uColor     = glGetUniformLocation(m_prog, "uColor");
     m_uTranslate = glGetUniformLocation(m_prog, "uTranslate");
+    m_uClip      = glGetUniformLocation(m_prog, "uClip");
+    m_uXfM       = glGetUniformLocation(m_prog, "uXfM");
+    m_uXfT       = glGetUniformLocation(m_prog, "uXfT");
+    m_uOpacity   = glGetUniformLocation(m_prog, "uOpacity");
+
+    // per-program constant (the same for every sharer); uMVP is set on change in drawItem()
+    glUseProgram(m_prog);
+    glUniform1i(m_uTex, 0);
+    glUseProgram(0);
 
-    logx::I("initProgram done");
+    logx::I("resolveProgram done");
     return true;
 }
 void TextRenderer::destroyProgram() {
-    if (m_prog) glDeleteProgram(m_prog);
+    if (m_shaders) m_shaders->release(m_progId);
+    if (m_ownShaders) m_ownShaders->shutdown();
+    m_progId = -1;
     m_prog = 0;
-    m_uMVP = m_uTex = m_uTranslate = -1;
-}
-
-/* ---------------- Font (FreeType + HarfBuzz) ---------------- */
-bool TextRenderer::initFont(int pixelSize) {
-    if (pixelSize <= 0) {
-        logx::E("initFont: invalid pixelSize");
-        return false;
-    }
-    
-    m_pxSize = pixelSize;
-    if (!m_ft) {
-        if (FT_Init_FreeType(&m_ft) != 0) return false;
-    }
-    
-    FT_Open_Args args{};
-    args.flags = FT_OPEN_MEMORY;
-    args.memory_base = reinterpret_cast<const FT_Byte*>(m_font.bytes.data());
-    args.memory_size = static_cast<FT_Long>(m_font.bytes.size());
-    
-    if (FT_Open_Face(m_ft, &args, (FT_Long)m_font.collectionIndex, &m_face) != 0) {
-        logx::E("FT_Open_Face failed (fd + collectionIndex)");
-        return false;
-    }
-    
-    if (!m_font.variationSettings.empty() && FT_HAS_MULTIPLE_MASTERS(m_face)) {
-        FT_MM_Var* mm = nullptr;
-        if (FT_Get_MM_Var(m_face, &mm) == 0 && mm) {
-            std::vector<FT_Fixed> coords(mm->num_axis);
-
-            // Start from defaults
-            for (FT_UInt a = 0; a < mm->num_axis; ++a) {
-                coords[a] = mm->axis[a].def;
-            }
-
-            // Map axis tag -> index, then override
-            for (const auto& [tag, val] : m_font.variationSettings) {
-                for (FT_UInt a = 0; a < mm->num_axis; ++a) {
-                    // FreeType stores axis tag as FT_ULong (big-endian 4-char tag)
-                    if ((uint32_t)mm->axis[a].tag == tag) {
-                        coords[a] = f2dot16(val);
-                        break;
-                    }
-                }
-            }
-
-            FT_Error err = FT_Set_Var_Design_Coordinates(m_face, (FT_UInt)coords.size(), coords.data());
-            if (err) {
-                logx::Ef("FT_Set_Var_Design_Coordinates returned FT_Error({})", err);
-                return false;
-            }
-            FT_Done_MM_Var(m_ft, mm);
-        }
-    }
-    
-    if (FT_Set_Pixel_Sizes(m_face, 0, (FT_UInt)pixelSize) != 0) {
-        logx::E("FT_Set_Pixel_Sizes failed");
-        FT_Done_Face(m_face); m_face = nullptr;
-        return false;
-    }
-
-    m_hbFont = hb_ft_font_create_referenced(m_face);
-    if (!m_hbFont) {
-        logx::E("hb_ft_font_create_referenced failed");
-        FT_Done_Face(m_face); m_face = nullptr;
-        return false;
-    }
-    hb_ft_font_set_funcs(m_hbFont);
-    hb_font_set_scale(m_hbFont,
-                      (int)m_face->size->metrics.x_ppem * 64,
-                      (int)m_face->size->metrics.y_ppem * 64);
-    
-    auto& m = m_face->size->metrics;
-
-    // In FreeType, ascent is positive, descent is negative (typically).
-    float asc = (float)m.ascender / 64.0f;
-    float desc = (float)(-m.descender) / 64.0f; // make it positive magnitude
-    float gap = (float)(m.height - (m.ascender - m.descender)) / 64.0f; // optional
-
-    m_lm.ascent  = asc;
-    m_lm.descent = desc;
-    m_lm.lineGap = std::max(0.0f, gap);
-    
-    logx::I("initFont done");
-    return true;
-}
-void TextRenderer::destroyFont() {
-    if (m_hbFont) hb_font_destroy(m_hbFont);
-    if (m_face) FT_Done_Face(m_face);
-    m_hbFont = nullptr;
-    m_face = nullptr;
-    m_pxSize = 0;
+    m_uMVP = m_uTex = m_uTranslate = m_uClip = -1;
+    m_uXfM = m_uXfT = m_uOpacity = -1;
 }
 
 /* ---------------- Atlas ---------------- */
-bool TextRenderer::initAtlas(int w, int h) {
-    m_atlasW = w; m_atlasH = h;
-    m_atlasPixels.assign((size_t)w * (size_t)h, 0);
-    m_penX = m_penY = m_rowH = 0;
-    m_atlasTex = 0;
-    m_atlasUploaded = false;
-    return true;
-}
 void TextRenderer::destroyAtlas() {
     if (m_atlasTex) glDeleteTextures(1, &m_atlasTex);
     m_atlasTex = 0;
-    m_atlasPixels.clear();
-    m_atlasW = m_atlasH = 0;
-    m_penX = m_penY = m_rowH = 0;
-    m_atlasUploaded = false;
-}
-bool TextRenderer::atlasAlloc(int w, int h, int& outX, int& outY) {
-    if (w <= 0 || h <= 0) return false;
-    if (w > m_atlasW || h > m_atlasH) return false;
-
-    if (m_penX + w > m_atlasW) {
-        m_penX = 0;
-        m_penY += m_rowH;
-        m_rowH = 0;
-    }
-    if (m_penY + h > m_atlasH) return false;
-
-    outX = m_penX;
-    outY = m_penY;
-
-    m_penX += w;
-    m_rowH = std::max(m_rowH, h);
-    return true;
 }
 void TextRenderer::uploadAtlasIfNeeded() {
-    if (m_atlasUploaded) return;
+    if (!m_shaper.atlasDirty()) return;
 
     if (!m_atlasTex) glGenTextures(1, &m_atlasTex);
     glBindTexture(GL_TEXTURE_2D, m_atlasTex);
@@ -397,163 +171,16 @@ void TextRenderer::uploadAtlasIfNeeded() {
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, 
-                 m_atlasW, m_atlasH, 0, 
-                 GL_RED, GL_UNSIGNED_BYTE, m_atlasPixels.data());
+                 m_shaper.atlasWidth(), m_shaper.atlasHeight(), 0, 
+                 GL_RED, GL_UNSIGNED_BYTE, m_shaper.atlasPixels());
+    if (m_prof) m_prof->count(ProfCounter::BytesUploaded, (uint64_t)m_shaper.atlasWidth() * m_shaper.atlasHeight());
     
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    m_atlasUploaded = true;
-}
-
-/* ---------------- Glyph cache / rasterize ---------------- */
-TextRenderer::GlyphEntry* TextRenderer::findGlyph(uint32_t gid) {
-    for (auto& g : m_glyphs) if (g.valid && g.gid == gid) return &g;
-    return nullptr;
-}
-TextRenderer::GlyphEntry* TextRenderer::insertGlyph(uint32_t gid) {
-    for (auto& g : m_glyphs) {
-        if (!g.valid) { g.valid = true; g.gid = gid; return &g; }
-    }
-    return nullptr;
-}
-bool TextRenderer::rasterizeGlyph(GlyphEntry& out, uint32_t gid) {
-    if (FT_Load_Glyph(m_face, gid,
-                      FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) != 0) {
-        return false;
-    }
-
-    FT_GlyphSlot gs = m_face->glyph;
-    FT_Bitmap* bm = &gs->bitmap;
-    const int w = (int)bm->width;
-    const int h = (int)bm->rows;
-
-    out.bearingX = gs->bitmap_left;
-    out.bearingY = gs->bitmap_top;
-    out.w = w;
-    out.h = h;
-
-    if (w == 0 || h == 0) {
-        out.u0 = out.v0 = out.u1 = out.v1 = 0.0f;
-        return true;
-    }
-
-    const int aw = w + 2 * kAtlasPad;
-    const int ah = h + 2 * kAtlasPad;
-
-    int x, y;
-    if (!atlasAlloc(aw, ah, x, y)) return false;
-
-    const int dstX = x + kAtlasPad;
-    const int dstY = y + kAtlasPad;
-
-    for (int row = 0; row < h; row++) {
-        uint8_t* dst = m_atlasPixels.data() + (size_t)(dstY + row) * (size_t)m_atlasW + (size_t)dstX;
-        const uint8_t* src = bm->buffer + (size_t)row * (size_t)bm->pitch;
-        std::memcpy(dst, src, (size_t)w);
-    }
-
-    out.u0 = (float)dstX / (float)m_atlasW;
-    out.v0 = (float)dstY / (float)m_atlasH;
-    out.u1 = (float)(dstX + w) / (float)m_atlasW;
-    out.v1 = (float)(dstY + h) / (float)m_atlasH;
-    return true;
-}
-
-/* ---------------- Shaping / mesh ---------------- */
-hb_buffer_t* TextRenderer::shapeUtf8(const char* utf8) {
-    hb_buffer_t* buf = hb_buffer_create();
-    hb_buffer_set_cluster_level(buf, HB_BUFFER_CLUSTER_LEVEL_MONOTONE_CHARACTERS);
-    hb_buffer_set_direction(buf, HB_DIRECTION_LTR);
-    //hb_buffer_set_script(buf, hb_script_from_string("Latn", -1));
-    //hb_buffer_set_language(buf, hb_language_from_string("en", -1));
-    hb_buffer_add_utf8(buf, utf8, -1, 0, -1);
-    hb_buffer_guess_segment_properties(buf);
-    hb_shape(m_hbFont, buf, nullptr, 0);
-    return buf;
-}
-void TextRenderer::addGlyphQuad(std::vector<TextVtx>& vb,
-                              float x0, float y0, float x1, float y1,
-                              float u0, float v0, float u1, float v1,
-                              const RGBA& c) {
-    vb.emplace_back(x0,y0,u0,v0,c);
-    vb.emplace_back(x1,y0,u1,v0,c);
-    vb.emplace_back(x1,y1,u1,v1,c);
-
-    vb.emplace_back(x0,y0,u0,v0,c);
-    vb.emplace_back(x1,y1,u1,v1,c);
-    vb.emplace_back(x0,y1,u0,v1,c);
-}
-
-bool TextRenderer::buildMesh(TextObj& t) {
-    t.mesh.clear();
-
-    t.cpByteOffsets = buildUtf8Index(t.text.c_str());
-    const int numCP = utf8_codepoint_count_from_index(t.cpByteOffsets);
-    t.caretX.assign((size_t)numCP + 1, 0.0f);
-
-    hb_buffer_t* buf = shapeUtf8(t.text.c_str());
-    const unsigned int count = hb_buffer_get_length(buf);
-    hb_glyph_info_t* infos = hb_buffer_get_glyph_infos(buf, nullptr);
-    hb_glyph_position_t* pos = hb_buffer_get_glyph_positions(buf, nullptr);
-
-    float penX = 0.0f;
-    float penY = 0.0f;
-
-    t.caretX[0] = 0.0f;
-
-    for (unsigned int i = 0; i < count; i++) {
-        uint32_t gid = infos[i].codepoint;
-
-        GlyphEntry* ge = findGlyph(gid);
-        if (!ge) {
-            ge = insertGlyph(gid);
-            if (!ge) { hb_buffer_destroy(buf); return false; }
-            *ge = GlyphEntry{};
-            ge->valid = true;
-            ge->gid = gid;
-            if (!rasterizeGlyph(*ge, gid)) { hb_buffer_destroy(buf); return false; }
-            m_atlasUploaded = false;
-        }
-
-        float xOff = (float)pos[i].x_offset  / 64.0f;
-        float yOff = (float)pos[i].y_offset  / 64.0f;
-        float xAdv = (float)pos[i].x_advance / 64.0f;
-        float yAdv = (float)pos[i].y_advance / 64.0f;
-
-        const int cpIdx = codepointIndexFromCluster(infos[i].cluster, t.cpByteOffsets);
-
-        // Draw quad
-        float gx = penX + xOff + (float)ge->bearingX;
-        float gy = penY - yOff - (float)ge->bearingY;
-        if (ge->w > 0 && ge->h > 0) {
-            addGlyphQuad(t.mesh,
-                         gx, gy, gx + (float)ge->w, gy + (float)ge->h,
-                         ge->u0, ge->v0, ge->u1, ge->v1, t.c);
-        }
-
-        // Advance pen
-        float nextPenX = penX + xAdv;
-        float nextPenY = penY + yAdv;
-
-        // Store caret for "after this character" (best-effort)
-        // Clamp index into [0..numCP]
-        int after = std::min(std::max(cpIdx + 1, 0), numCP);
-        t.caretX[(size_t)after] = std::max(t.caretX[(size_t)after], nextPenX);
-
-        penX = nextPenX;
-        penY = nextPenY;
-    }
-
-    hb_buffer_destroy(buf);
-
-    // Make caretX monotone and fill missing
-    for (int k = 1; k <= numCP; k++) {
-        t.caretX[(size_t)k] = std::max(t.caretX[(size_t)k], t.caretX[(size_t)k - 1]);
-    }
-    return true;
+    m_shaper.clearAtlasDirty();
 }
 
 /* ---------------- selection ---------------- */
@@ -568,8 +195,8 @@ TextRenderer::Handle TextRenderer::hitTest(float screenX, float screenY) const {
         float x0 = t.x;
         float x1 = t.x + t.caretX.back();
 
-        float y0 = t.baselineY - m_lm.ascent;
-        float y1 = t.baselineY + m_lm.descent;
+        float y0 = t.baselineY - m_shaper.lineMetrics().ascent;
+        float y1 = t.baselineY + m_shaper.lineMetrics().descent;
 
         if (pointInRect(screenX, screenY, x0, y0, x1, y1)) {
             return Handle{i};
@@ -585,8 +212,8 @@ int TextRenderer::caretFromPoint(Handle h, float screenX, float screenY) const {
 
     float localX = screenX - t.x;
     // For single-line, y only gates whether it's "on the line".
-    float y0 = t.baselineY - m_lm.ascent;
-    float y1 = t.baselineY + m_lm.descent;
+    float y0 = t.baselineY - m_shaper.lineMetrics().ascent;
+    float y1 = t.baselineY + m_shaper.lineMetrics().descent;
     if (screenY < y0 || screenY > y1) return -1;
 
     return caretIndexFromLocalX(t, localX);
@@ -644,8 +271,8 @@ TextRenderer::SelectionInfo TextRenderer::getSelectionInfo(Handle h) const {
     // Full text bounds in screen space
     si.x0 = t.x;
     si.x1 = t.x + t.caretX.back();
-    si.y0 = t.baselineY - m_lm.ascent;
-    si.y1 = t.baselineY + m_lm.descent;
+    si.y0 = t.baselineY - m_shaper.lineMetrics().ascent;
+    si.y1 = t.baselineY + m_shaper.lineMetrics().descent;
 
     // Selection bounds (if any)
     int s0 = std::min(t.selA, t.selB);
@@ -676,11 +303,13 @@ TextRenderer::Handle TextRenderer::createText() {
             t.alive = true;
             t.cpuDirty = true;
             t.gpuDirty = true;
+            t.clip = m_clipStack.top();
             return Handle{i};
         }
     }
 
     TextObj t;
+    t.clip = m_clipStack.top();
     glGenBuffers(1, &t.vbo);
     glGenVertexArrays(1, &t.vao);
     setupTextVao(t.vao, t.vbo);
@@ -691,6 +320,7 @@ TextRenderer::Handle TextRenderer::createText() {
 void TextRenderer::destroyText(Handle h) {
     TextObj* t = get(h);
     if (!t) return;
+    if (m_damage) m_damage->add(t->drawn);
     
     if (t->vao) glDeleteVertexArrays(1, &t->vao);
     t->vao = 0;
@@ -714,56 +344,151 @@ void TextRenderer::setPos(Handle h, float x, float baselineY) {
     if (!t) return;
     t->x = x;
     t->baselineY = baselineY;
+    t->clip = m_clipStack.top();
+    t->changed = true;
+}
+void TextRenderer::setXform(Handle h, XformTable::Id xf) {
+    TextObj* t = get(h);
+    if (!t) return;
+    t->xf = xf;
+    t->changed = true;
+}
+void TextRenderer::setLayer(Handle h, uint8_t layer) {
+    TextObj* t = get(h);
+    if (!t) return;
+    t->layer = layer;
+    t->changed = true;
+}
+void TextRenderer::pushClip(float x, float y, float w, float h) {
+    m_clipStack.push(ClipRect::fromXYWH(x, y, w, h));
+}
+void TextRenderer::popClip() {
+    m_clipStack.pop();
 }
 void TextRenderer::setColor(Handle h, const RGBA& c) {
     TextObj* t = get(h);
     if (!t) return;
     t->c = c;
+    // the color is baked into the vertex mesh; its upload marks the damage
+    t->cpuDirty = true;
 }
 void TextRenderer::update() {
+    // Shape + mesh every dirty object in one batch (spread over worker threads);
+    // only the GL uploads below stay on this thread.
+    m_jobs.clear();
     for (auto& t : m_items) {
-        if (!t.alive) continue;
+        if (!t.alive || !t.cpuDirty) continue;
+        t.cpuDirty = false;
+        m_jobs.push_back(MeshJob{t.text.c_str(), t.c, &t});
+    }
+    if (!m_jobs.empty()) {
+        ProfScope ps(m_prof, ProfPhase::TextShape);
+        const uint64_t glyphs = m_shaper.glyphsRasterized();
+        m_shaper.buildMeshes(m_jobs);
+        if (m_prof) m_prof->count(ProfCounter::GlyphsRasterized, m_shaper.glyphsRasterized() - glyphs);
+    }
 
-        if (t.cpuDirty) {
-            t.cpuDirty = false;
-            if (!buildMesh(t)) {
-                logx::E("buildMesh failed");
-                t.mesh.clear();
-            } else {
-                logx::If("mesh verts: {}", t.mesh.size());
-                t.gpuDirty = true;
-            }
+    for (const MeshJob& j : m_jobs) {
+        TextObj& t = *static_cast<TextObj*>(j.out);
+        if (!j.ok) {
+            logx::E("buildMesh failed");
+            t.mesh.clear();
+        } else {
+            logx::If("mesh verts: {}", t.mesh.size());
+            t.gpuDirty = true;
         }
 
+        t.minX = t.minY = t.maxX = t.maxY = 0.0f;
+        if (!t.mesh.empty()) {
+            t.minX = t.maxX = t.mesh[0].x;
+            t.minY = t.maxY = t.mesh[0].y;
+        }
+        for (const TextVtx& v : t.mesh) {
+            t.minX = std::min(t.minX, v.x); t.maxX = std::max(t.maxX, v.x);
+            t.minY = std::min(t.minY, v.y); t.maxY = std::max(t.maxY, v.y);
+        }
+    }
+
+    ProfScope ps(m_prof, ProfPhase::TextUpload);
+    for (auto& t : m_items) {
+        if (!t.alive) continue;
+
         if (t.gpuDirty) {
             t.gpuDirty = false;
+            t.changed = true;
             glBindBuffer(GL_ARRAY_BUFFER, t.vbo);
             glBufferData(GL_ARRAY_BUFFER,
                          (GLsizeiptr)(t.mesh.size() * sizeof(TextVtx)),
                          t.mesh.data(),
                          GL_DYNAMIC_DRAW);
+            if (m_prof) m_prof->count(ProfCounter::BytesUploaded, t.mesh.size() * sizeof(TextVtx));
         }
     }
 
     uploadAtlasIfNeeded();
 }
+bool TextRenderer::needsRedraw() const {
+    for (const auto& t : m_items) {
+        if (!t.alive) continue;
+        if (t.cpuDirty || t.gpuDirty || t.changed) return true;
+        const Xform2D xf = m_xforms ? m_xforms->get(t.xf) : Xform2D{};
+        if (std::memcmp(&xf, &t.drawnXf, sizeof(Xform2D)) != 0) return true;
+    }
+    return false;
+}
 void TextRenderer::draw(const float* mvp4x4) {
-    if (!m_prog) return;
-
-    glUseProgram(m_prog);
-    glUniformMatrix4fv(m_uMVP, 1, GL_FALSE, mvp4x4);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_atlasTex);
-    glUniform1i(m_uTex, 0);
+    if (!resolveProgram()) return;
+    m_list.begin(mvp4x4);
+    submit(m_list);
+    m_list.flush();
+}
+void TextRenderer::submit(DrawList& list) {
+    if (!resolveProgram()) return;
 
-    for (auto& t : m_items) {
+    for (size_t i = 0; i < m_items.size(); i++) {
+        TextObj& t = m_items[i];
         if (!t.alive) continue;
 
-        //glUniform4f(m_uColor, t.r, t.g, t.b, t.a);
-        glUniform2f(m_uTranslate, t.x, t.baselineY);
-        glBindVertexArray(t.vao);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)t.mesh.size());
+        const Xform2D xf = m_xforms ? m_xforms->get(t.xf) : Xform2D{};
+        float bx0 = t.x + t.minX, by0 = t.baselineY + t.minY;
+        float bx1 = t.x + t.maxX, by1 = t.baselineY + t.maxY;
+        xf.applyBounds(bx0, by0, bx1, by1);
+        const bool visible = !t.mesh.empty() && xf.opacity > 0.0f && t.clip.overlaps(bx0, by0, bx1, by1);
+
+        if (t.changed || std::memcmp(&xf, &t.drawnXf, sizeof(Xform2D)) != 0) {
+            // bilinear atlas sampling can touch a pixel past the quads
+            const ClipRect now = visible ? ClipRect{bx0 - 1.0f, by0 - 1.0f, bx1 + 1.0f, by1 + 1.0f}.intersect(t.clip)
+                                         : ClipRect{};
+            if (m_damage) {
+                m_damage->add(t.drawn);
+                m_damage->add(now);
+            }
+            t.changed = false;
+            t.drawn = now;
+            t.drawnXf = xf;
+        }
+        if (!visible) continue;
+
+        list.submit(t.layer, kDepth, m_prog, m_atlasTex, BlendMode::Straight, &drawCmd, this, (uint32_t)i);
     }
-    glBindVertexArray(0);
+}
+void TextRenderer::drawCmd(void* ctx, uint32_t item, uint32_t, uint32_t, DrawList& list) {
+    auto* self = static_cast<TextRenderer*>(ctx);
+    self->drawItem(self->m_items[item], list);
+}
+void TextRenderer::drawItem(const TextObj& t, DrawList& list) {
+    list.state().useProgram(m_prog);
+    list.state().bindTexture(m_atlasTex);
+    m_shaders->setMvp(m_progId, m_uMVP, list.mvp());
+
+    const Xform2D xf = m_xforms ? m_xforms->get(t.xf) : Xform2D{};
+    //glUniform4f(m_uColor, t.r, t.g, t.b, t.a);
+    glUniform2f(m_uTranslate, t.x, t.baselineY);
+    glUniform4f(m_uClip, t.clip.x0, t.clip.y0, t.clip.x1, t.clip.y1);
+    glUniform4f(m_uXfM, xf.a, xf.b, xf.c, xf.d);
+    glUniform2f(m_uXfT, xf.tx, xf.ty);
+    glUniform1f(m_uOpacity, xf.opacity);
+    glBindVertexArray(t.vao);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)t.mesh.size());
+    if (m_prof) m_prof->count(ProfCounter::DrawCalls, 1);
 }
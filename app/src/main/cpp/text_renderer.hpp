@@ -3,29 +3,23 @@
 
 #include <GLES3/gl3.h>
 
-#include <hb.h>
-#include <hb-ft.h>
-#include <ft2build.h>
-#include FT_FREETYPE_H
-#include FT_OUTLINE_H
-#include FT_MULTIPLE_MASTERS_H
-
 #include "assets.hpp"
 #include "types.hpp"
+#include "text_shaper.hpp"
+#include "clip.hpp"
+#include "xform.hpp"
+#include "damage.hpp"
+#include "draw_list.hpp"
+#include "shader_library.hpp"
+#include "profiler.hpp"
 
 #include <cstdint>
 #include <cstddef>
+#include <string_view>
+#include <memory>
 #include <vector>
 #include <string>
 
-struct TextVtx {
-    float x, y;
-    float u, v;
-    uint8_t r, g, b, a;
-    TextVtx(float px, float py, float u, float v, const RGBA& c)
-     : x(px), y(py), u(u), v(v), r(c.r), g(c.g), b(c.b), a(c.a) {}
-};
-
 class TextRenderer {
 public:
     
@@ -43,6 +37,21 @@ public:
               int atlasW = 2048,
               int atlasH = 2048);
 
+    // init() in parts, so the slow half can run off the render thread:
+    //   initFont() - FreeType face + CPU atlas, no GL. May run on a worker thread
+    //                while nothing else uses this renderer (see AsyncLoader).
+    //   prewarm()  - rasterize the glyphs of utf8 into the CPU atlas; same rules.
+    //   initGl()   - requests the text shader program; needs the EGL context.
+    //                Doesn't touch the font, so it may overlap initFont().
+    bool initFont(Assets::Font&& font, int pixelSize, int atlasW = 2048, int atlasH = 2048);
+    bool prewarm(const char* utf8) { return m_shaper.prewarm(utf8); }
+    // A GlyphAtlas baked into the asset bundle instead of prewarm(); same rules.
+    bool loadAtlas(const Assets::AssetView& v) { return m_shaper.loadAtlas(v.data(), v.size()); }
+    bool initGl(const Assets::AssetView& vert, const Assets::AssetView& frag);
+    // The program from initGl() has linked (or failed): the first draw won't
+    // wait on the driver.
+    bool programReady() const { return m_prog || !m_shaders || m_shaders->ready(m_progId); }
+
     // Must be called before EGL context is destroyed (or while context is current).
     void shutdown();
 
@@ -55,15 +64,55 @@ public:
     void setPos(Handle h, float x, float baselineY);
     void setColor(Handle h, const RGBA& c);
 
+    // Clip stack (screen space), same semantics as UiRenderer::pushClip.
+    // createText()/setPos() attach the current clip to the object; draw()
+    // masks glyphs against it in text.frag and skips objects entirely outside.
+    void pushClip(float x, float y, float w, float h);
+    void popClip();
+
+    // Attach objects to transform slots of a shared table (usually
+    // UiRenderer::xforms()), so a label moves/fades with its button.
+    // Slot 0 or no table = untransformed. The clip stays in screen space.
+    void setXformTable(const XformTable* table) { m_xforms = table; }
+    void setXform(Handle h, XformTable::Id xf);
+
+    // The framebuffer encodes sRGB on write (see UiRenderer::setColorOutput):
+    // text.vert then linearizes vertex colors. Call before init().
+    void setSrgbTarget(bool on) { m_srgbTarget = on; }
+
+    // See UiRenderer::setShaderLibrary; renderers with the same shaders and
+    // sRGB setting share one program. Call before initGl().
+    void setShaderLibrary(ShaderLibrary* lib) { m_shaders = lib; }
+
+    // See UiRenderer::setDamage: submit() adds the old and new screen bounds
+    // of every label whose mesh, position, color, layer or transform slot
+    // changed; destroyText() adds what the label covered.
+    void setDamage(Damage* damage) { m_damage = damage; }
+    // Some label changed since the last submit (or has text still to shape).
+    bool needsRedraw() const;
+
+    // update() times TextShape/TextUpload and counts uploads, rasterized
+    // glyphs and draw calls into *prof (not owned; null = off).
+    void setProfiler(Profiler* prof) { m_prof = prof; }
+
     // Call once per frame (or only when you know something changed).
     void update();
 
     // Draw using internal program.
     void draw(const float* mvp4x4);
 
+    // Frame draw list (see DrawList): one command per visible object at
+    // (layer, kDepth), keyed by this renderer's atlas, so the labels of a layer
+    // group by atlas across TextRenderers. Labels sharing a layer are assumed
+    // not to overlap each other; put text under a panel on a lower layer.
+    static constexpr uint16_t kDepth = 2;
+    void setLayer(Handle h, uint8_t layer);
+    void submit(DrawList& list);
+
     // Optional: expose program/atlas (useful for debugging)
     GLuint program() const { return m_prog; }
     GLuint atlasTexture() const { return m_atlasTex; }
+    const TextShaper& shaper() const { return m_shaper; }
     
     // Returns handle of topmost hit text object, or {-1} if none.
     Handle hitTest(float screenX, float screenY) const;
@@ -98,45 +147,24 @@ public:
     };
     SelectionInfo getSelectionInfo(Handle h) const;
     
-    struct GlyphMetrics {
-        bool  valid = false;
-    
-        // Glyph ID used (after cmap lookup)
-        uint32_t gid = 0;
-    
-        // Bitmap box (pixels) like your cached rasterized glyph
-        int bmpW = 0;
-        int bmpH = 0;
-        int bearingX = 0; // bitmap_left
-        int bearingY = 0; // bitmap_top
-    
-        // Advances (pixels in your local text space)
-        float advanceX = 0.0f;
-        float advanceY = 0.0f;
-    
-        // Optional: font-space bbox (more “true” outline bounds), converted to pixels
-        float bboxXMin = 0.0f;
-        float bboxYMin = 0.0f;
-        float bboxXMax = 0.0f;
-        float bboxYMax = 0.0f;
-    };
+    using GlyphMetrics = TextShaper::GlyphMetrics;
     GlyphMetrics measureCodepoint(uint32_t codepoint) const;
     GlyphMetrics measureUtf8Glyph(const char* utf8, int byteOffset = 0) const; // convenience
 private:
     // ----- Text objects -----
-    struct TextObj {
+    // mesh / cpByteOffsets / caretX come from TextLayout (filled by TextShaper::buildMesh)
+    struct TextObj : TextLayout {
         float x=0, baselineY=0;
         RGBA c;
         //float r=1, g=1, b=1, a=1;
         std::string text;
 
-        std::vector<TextVtx> mesh;
         GLuint vbo = 0;
         GLuint vao = 0;
 
-        // --- shaping / selection support ---
-        std::vector<uint32_t> cpByteOffsets; // codepoint index -> utf8 byte offset (size = N+1)
-        std::vector<float>    caretX;        // caret positions in local text space (size = N+1)
+        ClipRect clip = ClipRect::none();
+        XformTable::Id xf = 0;
+        float minX=0, minY=0, maxX=0, maxY=0; // mesh bounds, local space
     
         // --- selection state ---
         bool selectable = true;
@@ -147,52 +175,21 @@ private:
         
         bool cpuDirty = true;
         bool gpuDirty = true;
+        bool changed = true;       // since the last submit (damage tracking)
+        ClipRect drawn{};          // screen bounds last submitted, empty if culled
+        Xform2D drawnXf{};
         bool alive = true;
+        uint8_t layer = 0;
     };
-    struct LineMetrics {
-        float ascent;   // +down or +up depends on your convention; below assumes y+down screen space
-        float descent;
-        float lineGap;
-        float height() const { return ascent + descent + lineGap; }
-    };
-    
     // ----- Program -----
-    bool initProgram(const Assets::Manager& am);
+    bool initProgram(const Assets::AssetView& vs, const Assets::AssetView& fs);
     void destroyProgram();
-    static GLuint compileShader(GLenum type, const char* src);
-    static GLuint linkProgram(const char* vs, const char* fs);
-
-    // ----- Font (FreeType + HarfBuzz) -----
-    bool initFont(int pixelSize);
-    void destroyFont();
+    bool resolveProgram();
 
     // ----- Atlas -----
-    bool initAtlas(int w, int h);
     void destroyAtlas();
-    bool atlasAlloc(int w, int h, int& outX, int& outY);
     void uploadAtlasIfNeeded();
 
-    // ----- Glyph cache / rasterize -----
-    struct GlyphEntry {
-        uint32_t gid = 0;
-        float u0=0, v0=0, u1=0, v1=0;
-        int w=0, h=0;
-        int bearingX=0, bearingY=0;
-        bool valid=false;
-    };
-
-    GlyphEntry* findGlyph(uint32_t gid);
-    GlyphEntry* insertGlyph(uint32_t gid);
-    bool rasterizeGlyph(GlyphEntry& out, uint32_t gid);
-
-    // ----- Shaping / mesh -----
-    hb_buffer_t* shapeUtf8(const char* utf8);
-    void addGlyphQuad(std::vector<TextVtx>& vb,
-                      float x0, float y0, float x1, float y1,
-                      float u0, float v0, float u1, float v1,
-                      const RGBA& c);
-    bool buildMesh(TextObj& t);
-    
     static int caretIndexFromLocalX(const TextObj& t, float localX);
     
     TextObj* get(Handle h);
@@ -204,27 +201,28 @@ private:
     GLint  m_uTex = -1;
     //GLint  m_uColor = -1;
     GLint  m_uTranslate = -1;
-    
-    
-    // Font state
-    Assets::Font m_font{};
-    FT_Library   m_ft     = nullptr;
-    FT_Face      m_face   = nullptr;
-    hb_font_t*   m_hbFont = nullptr;
-    int          m_pxSize = 0;
-
-    // Atlas state
-    int m_atlasW=0, m_atlasH=0;
-    std::vector<uint8_t> m_atlasPixels; // A8
-    int m_penX=0, m_penY=0, m_rowH=0;
+    GLint  m_uClip = -1;
+    GLint  m_uXfM = -1;
+    GLint  m_uXfT = -1;
+    GLint  m_uOpacity = -1;
+    bool   m_srgbTarget = false;
+    ShaderLibrary* m_shaders = nullptr;
+    std::unique_ptr<ShaderLibrary> m_ownShaders;
+    ShaderLibrary::Id m_progId = -1;
+    DrawList m_list;        // draw() without an external list
+    void drawItem(const TextObj& t, DrawList& list);
+    static void drawCmd(void* ctx, uint32_t item, uint32_t, uint32_t, DrawList& list);
+    ClipStack m_clipStack;
+    const XformTable* m_xforms = nullptr;
+    Damage* m_damage = nullptr;
+    Profiler* m_prof = nullptr;
+    
+    
+    // Font + CPU atlas + glyph cache
+    TextShaper m_shaper;
     GLuint m_atlasTex = 0;
-    bool m_atlasUploaded = false;
-
-    static constexpr int kGlyphCacheMax = 512;
-    static constexpr int kAtlasPad = 1;
-    GlyphEntry m_glyphs[kGlyphCacheMax]{};
-    LineMetrics m_lm{};
 
     // Text objects
     std::vector<TextObj> m_items;
+    std::vector<MeshJob> m_jobs; // update() scratch
 };
\ No newline at end of file
@@ -0,0 +1,612 @@
+// text_shaper.cpp
+#include "text_shaper.hpp"
+#include "utf8.hpp"
+#include "worker_pool.hpp"
+
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#include "logging.hpp"
+static constexpr char NS[] = "TextS";
+using logx = logger::logx<NS>;
+
+static inline FT_Fixed f2dot16(float v) {
+    // FreeType uses 16.16 fixed-point for variation coordinates
+    // Round to nearest
+    double x = (double)v * 65536.0;
+    if (x >= 0.0) x += 0.5;
+    else         x -= 0.5;
+    return (FT_Fixed)x;
+}
+
+TextShaper::~TextShaper() {
+    shutdown();
+    if (m_ft) FT_Done_FreeType(m_ft);
+    m_ft = nullptr;
+}
+
+bool TextShaper::init(Assets::Font&& font, int pixelSize, int atlasW, int atlasH) {
+    shutdown();
+
+    m_font = std::move(font);
+    if (m_font.empty()) return false;
+
+    if (!initFont(pixelSize)) return false;
+    if (!initAtlas(atlasW, atlasH)) { destroyFont(); return false; }
+
+    std::memset(m_glyphs, 0, sizeof(m_glyphs));
+    return true;
+}
+void TextShaper::shutdown() {
+    destroyAtlas();
+    destroyFont();
+    std::memset(m_glyphs, 0, sizeof(m_glyphs));
+    m_font = Assets::Font{};
+}
+
+TextShaper::GlyphMetrics TextShaper::measureCodepoint(uint32_t cp) const {
+    GlyphMetrics gm{};
+
+    if (!m_face) return gm;
+
+    const FT_UInt gid = FT_Get_Char_Index(m_face, cp);
+    gm.gid = gid;
+    if (gid == 0) return gm; // missing glyph
+
+    // Load metrics (no render needed). You can keep your hinting policy here.
+    if (FT_Load_Glyph(m_face, gid, FT_LOAD_DEFAULT | FT_LOAD_NO_BITMAP) != 0) return gm;
+
+    const FT_GlyphSlot slot = m_face->glyph;
+
+    // Advance in 26.6 fixed-point
+    gm.advanceX = (float)slot->advance.x / 64.0f;
+    gm.advanceY = (float)slot->advance.y / 64.0f;
+
+    // If you want bitmap metrics exactly like your atlas rendering uses:
+    // do a render load (costly but accurate for bitmap box)
+    if (FT_Load_Glyph(m_face, gid, FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) == 0) {
+        gm.bmpW = (int)slot->bitmap.width;
+        gm.bmpH = (int)slot->bitmap.rows;
+        gm.bearingX = slot->bitmap_left;
+        gm.bearingY = slot->bitmap_top;
+    }
+
+    // Outline bbox (works when outline exists); in font units -> convert to pixels.
+    if (slot->format == FT_GLYPH_FORMAT_OUTLINE) {
+        FT_BBox bb;
+        FT_Outline_Get_CBox(&slot->outline, &bb); // 26.6 units
+        gm.bboxXMin = (float)bb.xMin / 64.0f;
+        gm.bboxYMin = (float)bb.yMin / 64.0f;
+        gm.bboxXMax = (float)bb.xMax / 64.0f;
+        gm.bboxYMax = (float)bb.yMax / 64.0f;
+    }
+
+    gm.valid = true;
+    return gm;
+}
+
+/* ---------------- Font (FreeType + HarfBuzz) ---------------- */
+bool TextShaper::initFont(int pixelSize) {
+    if (pixelSize <= 0) {
+        logx::E("initFont: invalid pixelSize");
+        return false;
+    }
+
+    m_pxSize = pixelSize;
+    if (!m_ft) {
+        if (FT_Init_FreeType(&m_ft) != 0) return false;
+    }
+
+    if (!openFace(m_ft, m_face)) return false;
+
+    m_hbFont = createHbFont(m_face);
+    if (!m_hbFont) {
+        FT_Done_Face(m_face); m_face = nullptr;
+        return false;
+    }
+
+    m_ctx.assign(1, ShapeCtx{nullptr, m_face, m_hbFont, hb_buffer_create()});
+
+    auto& m = m_face->size->metrics;
+
+    // In FreeType, ascent is positive, descent is negative (typically).
+    float asc = (float)m.ascender / 64.0f;
+    float desc = (float)(-m.descender) / 64.0f; // make it positive magnitude
+    float gap = (float)(m.height - (m.ascender - m.descender)) / 64.0f; // optional
+
+    m_lm.ascent  = asc;
+    m_lm.descent = desc;
+    m_lm.lineGap = std::max(0.0f, gap);
+
+    logx::I("initFont done");
+    return true;
+}
+bool TextShaper::openFace(FT_Library lib, FT_Face& face) {
+    FT_Open_Args args{};
+    args.flags = FT_OPEN_MEMORY;
+    // m_font stays alive (and mapped) as long as any face on it
+    args.memory_base = reinterpret_cast<const FT_Byte*>(m_font.data());
+    args.memory_size = static_cast<FT_Long>(m_font.size());
+
+    if (FT_Open_Face(lib, &args, (FT_Long)m_font.collectionIndex, &face) != 0) {
+        logx::E("FT_Open_Face failed (memory + collectionIndex)");
+        return false;
+    }
+
+    if (!m_font.variationSettings.empty() && FT_HAS_MULTIPLE_MASTERS(face)) {
+        FT_MM_Var* mm = nullptr;
+        if (FT_Get_MM_Var(face, &mm) == 0 && mm) {
+            std::vector<FT_Fixed> coords(mm->num_axis);
+
+            // Start from defaults
+            for (FT_UInt a = 0; a < mm->num_axis; ++a) {
+                coords[a] = mm->axis[a].def;
+            }
+
+            // Map axis tag -> index, then override
+            for (const auto& [tag, val] : m_font.variationSettings) {
+                for (FT_UInt a = 0; a < mm->num_axis; ++a) {
+                    // FreeType stores axis tag as FT_ULong (big-endian 4-char tag)
+                    if ((uint32_t)mm->axis[a].tag == tag) {
+                        coords[a] = f2dot16(val);
+                        break;
+                    }
+                }
+            }
+
+            FT_Error err = FT_Set_Var_Design_Coordinates(face, (FT_UInt)coords.size(), coords.data());
+            FT_Done_MM_Var(lib, mm);
+            if (err) {
+                logx::Ef("FT_Set_Var_Design_Coordinates returned FT_Error({})", err);
+                FT_Done_Face(face); face = nullptr;
+                return false;
+            }
+        }
+    }
+
+    if (FT_Set_Pixel_Sizes(face, 0, (FT_UInt)m_pxSize) != 0) {
+        logx::E("FT_Set_Pixel_Sizes failed");
+        FT_Done_Face(face); face = nullptr;
+        return false;
+    }
+    return true;
+}
+hb_font_t* TextShaper::createHbFont(FT_Face face) {
+    hb_font_t* font = hb_ft_font_create_referenced(face);
+    if (!font) {
+        logx::E("hb_ft_font_create_referenced failed");
+        return nullptr;
+    }
+    hb_ft_font_set_funcs(font);
+    hb_font_set_scale(font,
+                      (int)face->size->metrics.x_ppem * 64,
+                      (int)face->size->metrics.y_ppem * 64);
+    return font;
+}
+bool TextShaper::ensureCtx(unsigned worker) {
+    // Runs on the worker itself; only that worker ever touches m_ctx[worker].
+    ShapeCtx& ctx = m_ctx[worker];
+    if (ctx.font) return true;
+
+    // FT_Library is not thread-safe, so every worker gets its own.
+    if (!ctx.ft && FT_Init_FreeType(&ctx.ft) != 0) return false;
+    if (!ctx.face && !openFace(ctx.ft, ctx.face)) return false;
+    ctx.font = createHbFont(ctx.face);
+    if (!ctx.font) return false;
+    if (!ctx.buf) ctx.buf = hb_buffer_create();
+    return true;
+}
+void TextShaper::destroyCtxs() {
+    for (size_t i = 0; i < m_ctx.size(); i++) {
+        ShapeCtx& ctx = m_ctx[i];
+        if (ctx.buf) hb_buffer_destroy(ctx.buf);
+        if (i == 0) continue; // ctx 0 aliases m_face/m_hbFont
+        if (ctx.font) hb_font_destroy(ctx.font);
+        if (ctx.face) FT_Done_Face(ctx.face);
+        if (ctx.ft) FT_Done_FreeType(ctx.ft);
+    }
+    m_ctx.clear();
+}
+void TextShaper::destroyFont() {
+    destroyCtxs();
+    if (m_hbFont) hb_font_destroy(m_hbFont);
+    if (m_face) FT_Done_Face(m_face);
+    m_hbFont = nullptr;
+    m_face = nullptr;
+    m_pxSize = 0;
+}
+
+/* ---------------- Atlas ---------------- */
+bool TextShaper::initAtlas(int w, int h) {
+    m_atlasW = w; m_atlasH = h;
+    m_atlasPixels.assign((size_t)w * (size_t)h, 0);
+    m_penX = m_penY = m_rowH = 0;
+    m_atlasDirty = true;
+    return true;
+}
+void TextShaper::destroyAtlas() {
+    m_atlasPixels.clear();
+    m_atlasW = m_atlasH = 0;
+    m_penX = m_penY = m_rowH = 0;
+    m_atlasDirty = false;
+}
+bool TextShaper::atlasAlloc(int w, int h, int& outX, int& outY) {
+    if (w <= 0 || h <= 0) return false;
+    if (w > m_atlasW || h > m_atlasH) return false;
+
+    if (m_penX + w > m_atlasW) {
+        m_penX = 0;
+        m_penY += m_rowH;
+        m_rowH = 0;
+    }
+    if (m_penY + h > m_atlasH) return false;
+
+    outX = m_penX;
+    outY = m_penY;
+
+    m_penX += w;
+    m_rowH = std::max(m_rowH, h);
+    return true;
+}
+
+/* ---------------- Glyph cache / rasterize ---------------- */
+TextShaper::GlyphEntry* TextShaper::findGlyph(uint32_t gid) {
+    for (auto& g : m_glyphs) if (g.valid && g.gid == gid) return &g;
+    return nullptr;
+}
+const TextShaper::GlyphEntry* TextShaper::findGlyph(uint32_t gid) const {
+    for (auto& g : m_glyphs) if (g.valid && g.gid == gid) return &g;
+    return nullptr;
+}
+TextShaper::GlyphEntry* TextShaper::insertGlyph(uint32_t gid) {
+    for (auto& g : m_glyphs) {
+        if (!g.valid) { g.valid = true; g.gid = gid; return &g; }
+    }
+    return nullptr;
+}
+void TextShaper::clearGlyphs() {
+    std::memset(m_glyphs, 0, sizeof(m_glyphs));
+    // only rows the shelf packer has touched can be non-zero
+    const int usedRows = std::min(m_atlasH, m_penY + m_rowH);
+    std::memset(m_atlasPixels.data(), 0, (size_t)usedRows * (size_t)m_atlasW);
+    m_penX = m_penY = m_rowH = 0;
+    m_atlasDirty = true;
+}
+bool TextShaper::rasterizeGlyph(GlyphEntry& out, uint32_t gid) {
+    if (FT_Load_Glyph(m_face, gid,
+                      FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) != 0) {
+        return false;
+    }
+
+    FT_GlyphSlot gs = m_face->glyph;
+    FT_Bitmap* bm = &gs->bitmap;
+    return placeGlyph(out, bm->buffer, bm->pitch, (int)bm->width, (int)bm->rows,
+                      gs->bitmap_left, gs->bitmap_top);
+}
+bool TextShaper::renderGlyph(FT_Face face, uint32_t gid, RasterGlyph& out) {
+    out.gid = gid;
+    out.ok = false;
+    if (FT_Load_Glyph(face, gid,
+                      FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) != 0) {
+        return false;
+    }
+
+    FT_GlyphSlot gs = face->glyph;
+    FT_Bitmap* bm = &gs->bitmap;
+    out.w = (int)bm->width;
+    out.h = (int)bm->rows;
+    out.bearingX = gs->bitmap_left;
+    out.bearingY = gs->bitmap_top;
+    out.px.resize((size_t)out.w * (size_t)out.h);
+    for (int row = 0; row < out.h; row++) {
+        std::memcpy(out.px.data() + (size_t)row * (size_t)out.w,
+                    bm->buffer + (size_t)row * (size_t)bm->pitch, (size_t)out.w);
+    }
+    out.ok = true;
+    return true;
+}
+bool TextShaper::placeGlyph(GlyphEntry& out, const uint8_t* src, int pitch,
+                            int w, int h, int bearingX, int bearingY) {
+    m_glyphsRasterized++;
+    out.bearingX = bearingX;
+    out.bearingY = bearingY;
+    out.w = w;
+    out.h = h;
+
+    if (w == 0 || h == 0) {
+        out.u0 = out.v0 = out.u1 = out.v1 = 0.0f;
+        return true;
+    }
+
+    const int aw = w + 2 * kAtlasPad;
+    const int ah = h + 2 * kAtlasPad;
+
+    int x, y;
+    if (!atlasAlloc(aw, ah, x, y)) return false;
+
+    const int dstX = x + kAtlasPad;
+    const int dstY = y + kAtlasPad;
+
+    for (int row = 0; row < h; row++) {
+        uint8_t* dst = m_atlasPixels.data() + (size_t)(dstY + row) * (size_t)m_atlasW + (size_t)dstX;
+        std::memcpy(dst, src + (size_t)row * (size_t)pitch, (size_t)w);
+    }
+
+    out.u0 = (float)dstX / (float)m_atlasW;
+    out.v0 = (float)dstY / (float)m_atlasH;
+    out.u1 = (float)(dstX + w) / (float)m_atlasW;
+    out.v1 = (float)(dstY + h) / (float)m_atlasH;
+    m_atlasDirty = true;
+    return true;
+}
+
+/* ---------------- Shaping / mesh ---------------- */
+hb_buffer_t* TextShaper::shapeUtf8(const char* utf8) {
+    hb_buffer_t* buf = hb_buffer_create();
+    hb_buffer_set_cluster_level(buf, HB_BUFFER_CLUSTER_LEVEL_MONOTONE_CHARACTERS);
+    hb_buffer_set_direction(buf, HB_DIRECTION_LTR);
+    //hb_buffer_set_script(buf, hb_script_from_string("Latn", -1));
+    //hb_buffer_set_language(buf, hb_language_from_string("en", -1));
+    hb_buffer_add_utf8(buf, utf8, -1, 0, -1);
+    hb_buffer_guess_segment_properties(buf);
+    hb_shape(m_hbFont, buf, nullptr, 0);
+    return buf;
+}
+void TextShaper::addGlyphQuad(std::vector<TextVtx>& vb,
+                              float x0, float y0, float x1, float y1,
+                              float u0, float v0, float u1, float v1,
+                              const RGBA& c) {
+    vb.emplace_back(x0,y0,u0,v0,c);
+    vb.emplace_back(x1,y0,u1,v0,c);
+    vb.emplace_back(x1,y1,u1,v1,c);
+
+    vb.emplace_back(x0,y0,u0,v0,c);
+    vb.emplace_back(x1,y1,u1,v1,c);
+    vb.emplace_back(x0,y1,u0,v1,c);
+}
+
+void TextShaper::shape(ShapeCtx& ctx, const char* utf8, std::vector<ShapedGlyph>& out) {
+    hb_buffer_t* buf = ctx.buf;
+    hb_buffer_clear_contents(buf);
+    hb_buffer_set_cluster_level(buf, HB_BUFFER_CLUSTER_LEVEL_MONOTONE_CHARACTERS);
+    hb_buffer_set_direction(buf, HB_DIRECTION_LTR);
+    hb_buffer_add_utf8(buf, utf8, -1, 0, -1);
+    hb_buffer_guess_segment_properties(buf);
+    hb_shape(ctx.font, buf, nullptr, 0);
+
+    const unsigned int count = hb_buffer_get_length(buf);
+    const hb_glyph_info_t* infos = hb_buffer_get_glyph_infos(buf, nullptr);
+    const hb_glyph_position_t* pos = hb_buffer_get_glyph_positions(buf, nullptr);
+
+    out.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        out[i] = ShapedGlyph{infos[i].codepoint, infos[i].cluster,
+                             pos[i].x_offset, pos[i].y_offset,
+                             pos[i].x_advance, pos[i].y_advance};
+    }
+}
+bool TextShaper::ensureGlyphs(const std::vector<ShapedGlyph>& glyphs) {
+    for (const ShapedGlyph& g : glyphs) {
+        if (findGlyph(g.gid)) continue;
+        GlyphEntry* ge = insertGlyph(g.gid);
+        if (!ge) return false;
+        *ge = GlyphEntry{};
+        ge->valid = true;
+        ge->gid = g.gid;
+        if (!rasterizeGlyph(*ge, g.gid)) { ge->valid = false; return false; }
+    }
+    return true;
+}
+bool TextShaper::layoutMesh(const std::vector<ShapedGlyph>& glyphs, const RGBA& c, TextLayout& t) const {
+    t.mesh.clear();
+
+    const int numCP = utf8::codepointCount(t.cpByteOffsets);
+    t.caretX.assign((size_t)numCP + 1, 0.0f);
+
+    float penX = 0.0f;
+    float penY = 0.0f;
+
+    t.caretX[0] = 0.0f;
+
+    for (const ShapedGlyph& g : glyphs) {
+        const GlyphEntry* ge = findGlyph(g.gid);
+        if (!ge) return false;
+
+        float xOff = (float)g.xOff / 64.0f;
+        float yOff = (float)g.yOff / 64.0f;
+        float xAdv = (float)g.xAdv / 64.0f;
+        float yAdv = (float)g.yAdv / 64.0f;
+
+        const int cpIdx = utf8::codepointIndexFromCluster(g.cluster, t.cpByteOffsets);
+
+        // Draw quad
+        float gx = penX + xOff + (float)ge->bearingX;
+        float gy = penY - yOff - (float)ge->bearingY;
+        if (ge->w > 0 && ge->h > 0) {
+            addGlyphQuad(t.mesh,
+                         gx, gy, gx + (float)ge->w, gy + (float)ge->h,
+                         ge->u0, ge->v0, ge->u1, ge->v1, c);
+        }
+
+        // Advance pen
+        float nextPenX = penX + xAdv;
+        float nextPenY = penY + yAdv;
+
+        // Store caret for "after this character" (best-effort)
+        // Clamp index into [0..numCP]
+        int after = std::min(std::max(cpIdx + 1, 0), numCP);
+        t.caretX[(size_t)after] = std::max(t.caretX[(size_t)after], nextPenX);
+
+        penX = nextPenX;
+        penY = nextPenY;
+    }
+
+    // Make caretX monotone and fill missing
+    for (int k = 1; k <= numCP; k++) {
+        t.caretX[(size_t)k] = std::max(t.caretX[(size_t)k], t.caretX[(size_t)k - 1]);
+    }
+    return true;
+}
+
+bool TextShaper::buildMesh(const char* utf8, const RGBA& c, TextLayout& t) {
+    if (m_ctx.empty()) return false;
+    if (m_shaped.empty()) m_shaped.resize(1);
+    std::vector<ShapedGlyph>& glyphs = m_shaped[0];
+
+    t.cpByteOffsets = utf8::buildIndex(utf8);
+    shape(m_ctx[0], utf8, glyphs);
+    if (!ensureGlyphs(glyphs)) return false;
+    return layoutMesh(glyphs, c, t);
+}
+bool TextShaper::prewarm(const char* utf8) {
+    if (m_ctx.empty()) return false;
+    if (m_shaped.empty()) m_shaped.resize(1);
+    shape(m_ctx[0], utf8, m_shaped[0]);
+    return ensureGlyphs(m_shaped[0]);
+}
+
+/* ---------------- Baked atlas ---------------- */
+namespace {
+struct AtlasHeader {
+    char magic[4];         // "ATL1"
+    int32_t pxSize, atlasW, atlasH;
+    int32_t penX, penY, rowH;
+    uint32_t glyphCount;
+    uint64_t fontSize, fontHash;
+};
+struct AtlasGlyph {
+    uint32_t gid;
+    float u0, v0, u1, v1;
+    int32_t w, h, bearingX, bearingY;
+};
+constexpr char kAtlasMagic[4] = {'A', 'T', 'L', '1'};
+
+// enough to tell fonts apart without reading all of one at startup
+uint64_t fontHash(const Assets::Font& f) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    const size_t n = std::min<size_t>(f.size(), 4096);
+    for (size_t i = 0; i < n; i++) { h ^= (unsigned char)f.data()[i]; h *= 0x100000001b3ull; }
+    return h;
+}
+}
+
+bool TextShaper::saveAtlas(std::vector<uint8_t>& out) const {
+    if (!m_face || m_atlasPixels.empty()) return false;
+    AtlasHeader h{};
+    std::memcpy(h.magic, kAtlasMagic, sizeof(h.magic));
+    h.pxSize = m_pxSize;
+    h.atlasW = m_atlasW; h.atlasH = m_atlasH;
+    h.penX = m_penX; h.penY = m_penY; h.rowH = m_rowH;
+    h.fontSize = m_font.size();
+    h.fontHash = fontHash(m_font);
+
+    std::vector<AtlasGlyph> glyphs;
+    for (const GlyphEntry& g : m_glyphs) {
+        if (!g.valid) continue;
+        glyphs.push_back({g.gid, g.u0, g.v0, g.u1, g.v1, g.w, g.h, g.bearingX, g.bearingY});
+    }
+    h.glyphCount = (uint32_t)glyphs.size();
+
+    const int usedRows = std::min(m_atlasH, m_penY + m_rowH);
+    const size_t pxBytes = (size_t)usedRows * (size_t)m_atlasW;
+    out.resize(sizeof(h) + glyphs.size() * sizeof(AtlasGlyph) + pxBytes);
+    uint8_t* p = out.data();
+    std::memcpy(p, &h, sizeof(h));                                      p += sizeof(h);
+    std::memcpy(p, glyphs.data(), glyphs.size() * sizeof(AtlasGlyph)); p += glyphs.size() * sizeof(AtlasGlyph);
+    std::memcpy(p, m_atlasPixels.data(), pxBytes);
+    return true;
+}
+bool TextShaper::loadAtlas(const void* data, size_t size) {
+    if (!m_face || !data || size < sizeof(AtlasHeader)) return false;
+    const auto* p = static_cast<const uint8_t*>(data);
+    AtlasHeader h;
+    std::memcpy(&h, p, sizeof(h));
+    if (std::memcmp(h.magic, kAtlasMagic, sizeof(h.magic)) != 0 ||
+        h.pxSize != m_pxSize || h.atlasW != m_atlasW || h.atlasH != m_atlasH ||
+        h.fontSize != m_font.size() || h.fontHash != fontHash(m_font)) {
+        logx::E("loadAtlas: baked for another font/size");
+        return false;
+    }
+    const int usedRows = std::min(h.atlasH, h.penY + h.rowH);
+    const size_t glyphBytes = (size_t)h.glyphCount * sizeof(AtlasGlyph);
+    const size_t pxBytes = (size_t)usedRows * (size_t)h.atlasW;
+    if (h.glyphCount > (uint32_t)kGlyphCacheMax || usedRows < 0 ||
+        size != sizeof(h) + glyphBytes + pxBytes) {
+        logx::E("loadAtlas: corrupt");
+        return false;
+    }
+
+    clearGlyphs();
+    p += sizeof(h);
+    for (uint32_t i = 0; i < h.glyphCount; i++, p += sizeof(AtlasGlyph)) {
+        AtlasGlyph g;
+        std::memcpy(&g, p, sizeof(g));
+        GlyphEntry& e = m_glyphs[i];
+        e = GlyphEntry{g.gid, g.u0, g.v0, g.u1, g.v1, g.w, g.h, g.bearingX, g.bearingY, true};
+    }
+    std::memcpy(m_atlasPixels.data(), p, pxBytes);
+    m_penX = h.penX; m_penY = h.penY; m_rowH = h.rowH;
+    m_atlasDirty = true;
+    return true;
+}
+
+void TextShaper::buildMeshes(std::span<MeshJob> jobs) {
+    WorkerPool& pool = WorkerPool::shared();
+    if (m_ctx.empty()) {
+        for (MeshJob& j : jobs) j.ok = false;
+        return;
+    }
+    if (jobs.size() < 2 || pool.workerCount() < 2) {
+        for (MeshJob& j : jobs) j.ok = buildMesh(j.utf8, j.c, *j.out);
+        return;
+    }
+
+    // Worker contexts are opened lazily by the workers themselves.
+    m_ctx.resize(pool.workerCount());
+    if (m_shaped.size() < jobs.size()) m_shaped.resize(jobs.size());
+
+    // 1) shape (parallel, glyph cache untouched)
+    pool.parallelFor(jobs.size(), [&](size_t i, unsigned w) {
+        MeshJob& j = jobs[i];
+        j.ok = ensureCtx(w);
+        if (!j.ok) { m_shaped[i].clear(); return; }
+        j.out->cpByteOffsets = utf8::buildIndex(j.utf8);
+        shape(m_ctx[w], j.utf8, m_shaped[i]);
+    });
+
+    // 2) collect cache misses in job order (first occurrence wins)
+    m_raster.clear();
+    for (size_t i = 0; i < jobs.size(); i++) {
+        for (const ShapedGlyph& g : m_shaped[i]) {
+            if (findGlyph(g.gid)) continue;
+            bool seen = false;
+            for (const RasterGlyph& r : m_raster) {
+                if (r.gid == g.gid) { seen = true; break; }
+            }
+            if (!seen) m_raster.push_back(RasterGlyph{g.gid});
+        }
+    }
+
+    // 3) rasterize misses (parallel), then insert into cache/atlas serially in that order
+    pool.parallelFor(m_raster.size(), [&](size_t i, unsigned w) {
+        if (ensureCtx(w)) renderGlyph(m_ctx[w].face, m_raster[i].gid, m_raster[i]);
+    });
+    for (const RasterGlyph& r : m_raster) {
+        if (!r.ok) continue;
+        GlyphEntry* ge = insertGlyph(r.gid);
+        if (!ge) break; // cache full: affected jobs fail in layoutMesh
+        *ge = GlyphEntry{};
+        ge->valid = true;
+        ge->gid = r.gid;
+        if (!placeGlyph(*ge, r.px.data(), r.w, r.w, r.h, r.bearingX, r.bearingY)) {
+            ge->valid = false;
+        }
+    }
+
+    // 4) build meshes (parallel, glyph cache read-only)
+    pool.parallelFor(jobs.size(), [&](size_t i, unsigned) {
+        MeshJob& j = jobs[i];
+        if (j.ok) j.ok = layoutMesh(m_shaped[i], j.c, *j.out);
+    });
+}
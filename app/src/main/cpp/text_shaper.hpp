@@ -0,0 +1,200 @@
+// text_shaper.hpp - platform-independent half of the text pipeline
+// (FreeType/HarfBuzz font, CPU glyph atlas, glyph cache, mesh building).
+// No GL/EGL/Android here so it can be built and benchmarked on the host.
+#pragma once
+
+#include <hb.h>
+#include <hb-ft.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+#include FT_MULTIPLE_MASTERS_H
+
+#include "font.hpp"
+#include "types.hpp"
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <string>
+
+struct TextVtx {
+    float x, y;
+    float u, v;
+    uint8_t r, g, b, a;
+    TextVtx(float px, float py, float u, float v, const RGBA& c)
+     : x(px), y(py), u(u), v(v), r(c.r), g(c.g), b(c.b), a(c.a) {}
+};
+
+// Output of buildMesh: glyph quads + caret data in local text space.
+struct TextLayout {
+    std::vector<TextVtx> mesh;
+    std::vector<uint32_t> cpByteOffsets; // codepoint index -> utf8 byte offset (size = N+1)
+    std::vector<float>    caretX;        // caret positions in local text space (size = N+1)
+};
+
+// One entry of a batch buildMeshes() call.
+struct MeshJob {
+    const char* utf8 = nullptr;
+    RGBA c;
+    TextLayout* out = nullptr;
+    bool ok = false;
+};
+
+class TextShaper {
+public:
+    TextShaper() = default;
+    ~TextShaper();
+
+    TextShaper(const TextShaper&) = delete;
+    TextShaper& operator=(const TextShaper&) = delete;
+
+    // Takes ownership of the font bytes (FreeType reads them in place).
+    bool init(Assets::Font&& font, int pixelSize, int atlasW, int atlasH);
+    void shutdown();
+
+    struct LineMetrics {
+        float ascent;   // +down or +up depends on your convention; below assumes y+down screen space
+        float descent;
+        float lineGap;
+        float height() const { return ascent + descent + lineGap; }
+    };
+    const LineMetrics& lineMetrics() const { return m_lm; }
+
+    struct GlyphMetrics {
+        bool  valid = false;
+
+        // Glyph ID used (after cmap lookup)
+        uint32_t gid = 0;
+
+        // Bitmap box (pixels) like your cached rasterized glyph
+        int bmpW = 0;
+        int bmpH = 0;
+        int bearingX = 0; // bitmap_left
+        int bearingY = 0; // bitmap_top
+
+        // Advances (pixels in your local text space)
+        float advanceX = 0.0f;
+        float advanceY = 0.0f;
+
+        // Optional: font-space bbox (more “true” outline bounds), converted to pixels
+        float bboxXMin = 0.0f;
+        float bboxYMin = 0.0f;
+        float bboxXMax = 0.0f;
+        float bboxYMax = 0.0f;
+    };
+    GlyphMetrics measureCodepoint(uint32_t codepoint) const;
+
+    // ----- Glyph cache / rasterize -----
+    struct GlyphEntry {
+        uint32_t gid = 0;
+        float u0=0, v0=0, u1=0, v1=0;
+        int w=0, h=0;
+        int bearingX=0, bearingY=0;
+        bool valid=false;
+    };
+    GlyphEntry* findGlyph(uint32_t gid);
+    const GlyphEntry* findGlyph(uint32_t gid) const;
+    GlyphEntry* insertGlyph(uint32_t gid);
+    bool rasterizeGlyph(GlyphEntry& out, uint32_t gid);
+    // Drops every cached glyph and resets the atlas to empty.
+    void clearGlyphs();
+
+    // ----- Atlas (CPU side, A8) -----
+    bool atlasAlloc(int w, int h, int& outX, int& outY);
+    int atlasWidth() const { return m_atlasW; }
+    int atlasHeight() const { return m_atlasH; }
+    const uint8_t* atlasPixels() const { return m_atlasPixels.data(); }
+    // Set whenever a glyph was rasterized into the atlas; the GL side clears it after upload.
+    bool atlasDirty() const { return m_atlasDirty; }
+    void clearAtlasDirty() { m_atlasDirty = false; }
+    // Glyphs rendered by FreeType and placed in the atlas since init (not loadAtlas).
+    uint64_t glyphsRasterized() const { return m_glyphsRasterized; }
+
+    // ----- Shaping / mesh -----
+    // Caller owns the returned buffer (hb_buffer_destroy).
+    hb_buffer_t* shapeUtf8(const char* utf8);
+    bool buildMesh(const char* utf8, const RGBA& c, TextLayout& out);
+    // Shapes utf8 and rasterizes any glyphs it needs into the atlas, no mesh.
+    bool prewarm(const char* utf8);
+    // Glyph cache + used atlas rows as one blob (BundleKind::GlyphAtlas), so a
+    // prewarm can be baked at build time. loadAtlas() replaces the cache and
+    // fails unless the blob was made from the same font bytes, pixel size and
+    // atlas size as init().
+    bool saveAtlas(std::vector<uint8_t>& out) const;
+    bool loadAtlas(const void* data, size_t size);
+    // Shapes/meshes independent jobs across WorkerPool::shared() (per-worker FT_Face,
+    // hb_font_t and hb_buffer_t). New glyphs are rasterized in parallel but inserted
+    // into the cache/atlas serially in job order, so the atlas layout is the same
+    // as with sequential buildMesh calls. Sets MeshJob::ok per job.
+    void buildMeshes(std::span<MeshJob> jobs);
+
+    static constexpr int kGlyphCacheMax = 512;
+    static constexpr int kAtlasPad = 1;
+
+private:
+    // Per-thread FreeType/HarfBuzz state. Index 0 is the owning thread and
+    // aliases m_face/m_hbFont; workers open their own face on the same bytes.
+    struct ShapeCtx {
+        FT_Library   ft   = nullptr; // null for ctx 0 (uses m_ft)
+        FT_Face      face = nullptr;
+        hb_font_t*   font = nullptr;
+        hb_buffer_t* buf  = nullptr;
+    };
+    struct ShapedGlyph {
+        uint32_t gid, cluster;
+        int32_t  xOff, yOff, xAdv, yAdv; // 26.6
+    };
+    struct RasterGlyph {
+        uint32_t gid = 0;
+        int w = 0, h = 0;
+        int bearingX = 0, bearingY = 0;
+        std::vector<uint8_t> px; // w*h, tightly packed
+        bool ok = false;
+    };
+
+    bool initFont(int pixelSize);
+    void destroyFont();
+    bool openFace(FT_Library lib, FT_Face& face);
+    hb_font_t* createHbFont(FT_Face face);
+    bool ensureCtx(unsigned worker);
+    void destroyCtxs();
+    bool initAtlas(int w, int h);
+    void destroyAtlas();
+
+    void shape(ShapeCtx& ctx, const char* utf8, std::vector<ShapedGlyph>& out);
+    bool ensureGlyphs(const std::vector<ShapedGlyph>& glyphs);
+    bool layoutMesh(const std::vector<ShapedGlyph>& glyphs, const RGBA& c, TextLayout& t) const;
+    static bool renderGlyph(FT_Face face, uint32_t gid, RasterGlyph& out);
+    bool placeGlyph(GlyphEntry& out, const uint8_t* src, int pitch,
+                    int w, int h, int bearingX, int bearingY);
+
+    static void addGlyphQuad(std::vector<TextVtx>& vb,
+                             float x0, float y0, float x1, float y1,
+                             float u0, float v0, float u1, float v1,
+                             const RGBA& c);
+
+private:
+    // Font state
+    Assets::Font m_font{};
+    FT_Library   m_ft     = nullptr;
+    FT_Face      m_face   = nullptr;
+    hb_font_t*   m_hbFont = nullptr;
+    int          m_pxSize = 0;
+    LineMetrics  m_lm{};
+
+    // Atlas state
+    int m_atlasW=0, m_atlasH=0;
+    std::vector<uint8_t> m_atlasPixels; // A8
+    int m_penX=0, m_penY=0, m_rowH=0;
+    bool m_atlasDirty = false;
+    uint64_t m_glyphsRasterized = 0;
+
+    GlyphEntry m_glyphs[kGlyphCacheMax]{};
+
+    // Batch/parallel scratch (kept to reuse capacity across updates)
+    std::vector<ShapeCtx> m_ctx;
+    std::vector<std::vector<ShapedGlyph>> m_shaped;
+    std::vector<RasterGlyph> m_raster;
+};
@@ -3,71 +3,20 @@
 #include "ui_renderer.hpp"
 
 #include <bit>
+#include <array>
+#include <type_traits>
+#include <cmath>
+#include <string>
 #include <cstring>
 #include <cstddef>
 #include <algorithm>
 #include <stdexcept>
 
+#include "half.hpp"
 #include "logging.hpp"
 static constexpr char NS[] = "UiR";
 using logx = logger::logx<NS>;
 
-static void logShader(GLuint s, const char* label) {
-    GLint len = 0;
-    glGetShaderiv(s, GL_INFO_LOG_LENGTH, &len);
-    if (len > 1) {
-        std::vector<char> buf((size_t)len);
-        glGetShaderInfoLog(s, len, nullptr, buf.data());
-        logx::Ef("{} Ui shader log:\n{}", label, buf.data());
-    }
-}
-static void logProgram(GLuint p) {
-    GLint len = 0;
-    glGetProgramiv(p, GL_INFO_LOG_LENGTH, &len);
-    if (len > 1) {
-        std::vector<char> buf((size_t)len);
-        glGetProgramInfoLog(p, len, nullptr, buf.data());
-        logx::Ef("Ui program log:\n{}", buf.data());
-    }
-}
-
-static GLuint compileShader(GLenum type, const char* src) {
-    GLuint s = glCreateShader(type);
-    glShaderSource(s, 1, &src, nullptr);
-    glCompileShader(s);
-    GLint ok = 0;
-    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
-    if (!ok) {
-        logShader(s, (type == GL_VERTEX_SHADER) ? "VERT" : "FRAG");
-        glDeleteShader(s);
-        return 0;
-    }
-    return s;
-}
-static GLuint linkProgram(const char* vs, const char* fs) {
-    GLuint v = compileShader(GL_VERTEX_SHADER, vs);
-    GLuint f = compileShader(GL_FRAGMENT_SHADER, fs);
-    if (!v || !f) return 0;
-
-    GLuint p = glCreateProgram();
-    glAttachShader(p, v);
-    glAttachShader(p, f);
-
-    glLinkProgram(p);
-
-    glDeleteShader(v);
-    glDeleteShader(f);
-
-    GLint ok = 0;
-    glGetProgramiv(p, GL_LINK_STATUS, &ok);
-    if (!ok) {
-        logProgram(p);
-        glDeleteProgram(p);
-        return 0;
-    }
-    return p;
-}
-
 static inline void chooseDims(int texels, int maxSize, int& w, int& h) {
     // start with something cache-friendly; grow if needed
     w = std::min(maxSize, 1024);
@@ -83,117 +32,218 @@ static inline void chooseDims(int texels, int maxSize, int& w, int& h) {
 }
 static void ensureTex(GLuint& t) { if (!t) glGenTextures(1, &t); }
 static void destroyTex(GLuint& t) { if (t) { glDeleteTextures(1, &t); t = 0; } }
-static void uploadInstF(const std::vector<UiRectInst>& inst,
-                        GLuint& texF, int& wF, int& hF,
-                        GLenum internalFmt)
-{
-    const int texels = (int)inst.size() * 2;
-    if (texels <= 0) { wF = hF = 0; return; }
-
-    GLint maxTex = 0;
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTex);
-    chooseDims(texels, maxTex, wF, hF);
-
-    std::vector<float> buf((size_t)wF * (size_t)hF * 4, 0.0f);
-
-    for (int i = 0; i < (int)inst.size(); ++i) {
-        const UiRectInst& in = inst[(size_t)i];
-        const int base = i * 2;
-
-        int t0 = base + 0;
-        int x0 = t0 % wF, y0 = t0 / wF;
-        float* p0 = &buf[((size_t)y0 * (size_t)wF + (size_t)x0) * 4];
-        p0[0]=in.cx; p0[1]=in.cy; p0[2]=in.hx; p0[3]=in.hy;
-
-        int t1 = base + 1;
-        int x1 = t1 % wF, y1 = t1 / wF;
-        float* p1 = &buf[((size_t)y1 * (size_t)wF + (size_t)x1) * 4];
-        p1[0]=in.radius; p1[1]=in.feather; p1[2]=0.f; p1[3]=0.f;
-    }
-
-    if (!texF) glGenTextures(1, &texF);
-    glBindTexture(GL_TEXTURE_2D, texF);
+// (Re)specifies storage only; contents are filled by uploadInst* afterwards.
+static void allocInstTex(GLuint& tex, int w, int h, GLenum internalFmt, GLenum fmt, GLenum type) {
+    ensureTex(tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, (GLint)internalFmt, wF, hF, 0, GL_RGBA, GL_FLOAT, buf.data());
+    glTexImage2D(GL_TEXTURE_2D, 0, (GLint)internalFmt, w, h, 0, fmt, type, nullptr);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
-static void uploadInstU(const std::vector<UiRectInst>& inst,
-                        GLuint& texU, int& wU, int& hU)
-{
-    const int texels = (int)inst.size() * 4;
-    if (texels <= 0) { wU = hU = 0; return; }
-
-    GLint maxTex = 0;
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTex);
-    chooseDims(texels, maxTex, wU, hU);
-
-    std::vector<uint8_t> buf((size_t)wU * (size_t)hU * 4, 0);
-
-    auto writeRGBA = [&](int texelIndex, uint32_t packedRGBA) {
-        int x = texelIndex % wU;
-        int y = texelIndex / wU;
-        uint8_t* p = &buf[((size_t)y * (size_t)wU + (size_t)x) * 4];
-        p[0] = (uint8_t)((packedRGBA >> 0)  & 255u);
-        p[1] = (uint8_t)((packedRGBA >> 8)  & 255u);
-        p[2] = (uint8_t)((packedRGBA >> 16) & 255u);
-        p[3] = (uint8_t)((packedRGBA >> 24) & 255u);
-    };
-
-    for (int i = 0; i < (int)inst.size(); ++i) {
-        const UiRectInst& in = inst[(size_t)i];
-        const int base = i * 4;
-        writeRGBA(base + 0, in.tl);
-        writeRGBA(base + 1, in.tr);
-        writeRGBA(base + 2, in.br);
-        writeRGBA(base + 3, in.bl);
+// Uploads the linear texel range [t0, t1) of a w-wide texture (bound to GL_TEXTURE_2D)
+// from tightly packed `src`: partial first row, whole middle rows, partial last row.
+static void uploadTexelRange(int w, int t0, int t1, GLenum fmt, GLenum type,
+                             size_t texelBytes, const void* src) {
+    const uint8_t* p = static_cast<const uint8_t*>(src);
+    int t = t0;
+    if (t < t1 && t % w != 0) {
+        const int n = std::min(w - t % w, t1 - t);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, t % w, t / w, n, 1, fmt, type, p);
+        p += (size_t)n * texelBytes;
+        t += n;
+    }
+    const int rows = (t1 - t) / w;
+    if (rows > 0) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, t / w, w, rows, fmt, type, p);
+        p += (size_t)rows * (size_t)w * texelBytes;
+        t += rows * w;
+    }
+    if (t < t1) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, t / w, t1 - t, 1, fmt, type, p);
+    }
+}
+// signed 24-bit 20.4 fixed point, clamped
+static inline uint32_t packFix24(float v) {
+    const float q = std::clamp(v * 16.0f, -8388608.0f, 8388607.0f);
+    return (uint32_t)(int32_t)std::lrint(q) & 0xffffffu;
+}
+// sRGB8 -> linear light, the exact sRGB transfer curve (what an sRGB
+// framebuffer inverts on write). Alpha stays linear: byte / 255.
+static const float* srgbToLinearLut() {
+    static const auto lut = [] {
+        std::array<float, 256> t{};
+        for (int i = 0; i < 256; i++) {
+            const double c = i / 255.0;
+            t[i] = (float)(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+        }
+        return t;
+    }();
+    return lut.data();
+}
+static inline void packLinearF16(uint32_t rgba, uint16_t* dst) {
+    const float* lut = srgbToLinearLut();
+    const float f[4] = { lut[rgba & 0xff], lut[(rgba >> 8) & 0xff], lut[(rgba >> 16) & 0xff],
+                         (float)(rgba >> 24) * (1.0f / 255.0f) };
+    half::fromFloat4(f, dst);
+}
+// UiRectInst -> UiInstGpu / UiInstGpuF16; hx/hy/radius/stroke are contiguous,
+// so one 4-wide half conversion per instance (plus one per corner for F16).
+template <class Gpu>
+static void packInstances(const UiRectInst* src, size_t n, Gpu* dst) {
+    static_assert(offsetof(UiRectInst, stroke) == offsetof(UiRectInst, hx) + 3 * sizeof(float));
+    static_assert(offsetof(Gpu, stroke) == offsetof(Gpu, hx) + 3 * sizeof(uint16_t));
+    for (size_t i = 0; i < n; ++i) {
+        const UiRectInst& in = src[i];
+        Gpu& out = dst[i];
+        const uint32_t fea = (uint32_t)std::clamp(std::lrint(in.feather * 8.0f), 0l, 31l);
+        out.cxShape = packFix24(in.cx) | (((uint32_t)in.shape & 7u) | (fea << 3)) << 24;
+        out.cyState = packFix24(in.cy) | ((uint32_t)in.state << 24);
+        half::fromFloat4(&in.hx, &out.hx);
+        if constexpr (std::is_same_v<Gpu, UiInstGpuF16>) {
+            packLinearF16(in.tl, out.tl);
+            packLinearF16(in.tr, out.tr);
+            packLinearF16(in.br, out.br);
+            packLinearF16(in.bl, out.bl);
+        } else {
+            std::memcpy(&out.tl, &in.tl, 4 * sizeof(uint32_t));
+        }
     }
-
-    if (!texU) glGenTextures(1, &texU);
-    glBindTexture(GL_TEXTURE_2D, texU);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8UI, wU, hU, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, buf.data());
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
-static inline void pushRectInst(std::vector<UiRectInst>& dst, const UiQuad& qv) {
+static inline UiRectInst makeInst(UiShape shape, float cx, float cy, float hx, float hy,
+                                  const UiColors& cc, float radius, float stroke, float feather) {
+    UiRectInst inst{};
+    inst.cx = cx; inst.cy = cy;
+    inst.hx = hx; inst.hy = hy;
+    inst.radius  = radius;
+    inst.stroke  = stroke;
+    inst.feather = feather;
+    inst.shape   = shape;
+
+    const auto pcc = cc.pack();
+    inst.tl = pcc.tl;
+    inst.tr = pcc.tr;
+    inst.br = pcc.br;
+    inst.bl = pcc.bl;
+    return inst;
+}
+static inline UiRectInst makeRectInst(const UiQuad& qv, UiShape shape = UiShape::Rect, float stroke = 0.0f) {
     float x0 = std::min(qv.x0, qv.x1);
     float x1 = std::max(qv.x0, qv.x1);
     float y0 = std::min(qv.y0, qv.y1);
     float y1 = std::max(qv.y0, qv.y1);
 
-    const float cx = 0.5f*(x0 + x1);
-    const float cy = 0.5f*(y0 + y1);
-    const float hx = 0.5f*(x1 - x0);
-    const float hy = 0.5f*(y1 - y0);
-
-    UiRectInst inst{};
-    inst.cx = cx; inst.cy = cy;
-    inst.hx = hx; inst.hy = hy;
-    inst.radius  = qv.radius;
-    inst.feather = qv.feather;
-    
-    inst.tl = qv.cc.tl.pack();
-    inst.tr = qv.cc.tr.pack();
-    inst.br = qv.cc.br.pack();
-    inst.bl = qv.cc.bl.pack();
+    return makeInst(shape, 0.5f*(x0 + x1), 0.5f*(y0 + y1), 0.5f*(x1 - x0), 0.5f*(y1 - y0),
+                    qv.cc, qv.radius, stroke, qv.feather);
+}
 
-    dst.push_back(inst);
+// Capsule half axis: p0..p1 extended by the cap radius r at both ends.
+static inline void capsuleAxis(float x0, float y0, float x1, float y1, float r, float& ax, float& ay) {
+    ax = 0.5f*(x1 - x0); ay = 0.5f*(y1 - y0);
+    const float len = std::sqrt(ax*ax + ay*ay);
+    if (len > 1e-4f) {
+        const float s = (len + r) / len;
+        ax *= s; ay *= s;
+    } else {
+        ax = r; ay = 0.0f;
+    }
 }
 
 
 UiRenderer::~UiRenderer() { shutdown(); }
 
-bool UiRenderer::init(const Assets::Manager& am) {
-    return initProgram(am);
+const char* UiRenderer::backendName(Backend b) {
+    switch (b) {
+        case Backend::Auto:    return "Auto";
+        case Backend::Texture: return "Texture";
+        case Backend::Attrib:  return "Attrib";
+        case Backend::Ssbo:    return "Ssbo";
+    }
+    return "?";
+}
+UiRenderer::Backend UiRenderer::pickBackend(Backend wanted) const {
+    // UiInstGpu as attributes needs aCorner + 2 geometry + 4 color slots
+    GLint maxAttribs = 0;
+    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttribs);
+    const bool attribOk = maxAttribs >= 7;
+
+    GLint major = 0, minor = 0, vsSsbo = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 3 || (major == 3 && minor >= 1)) {
+        glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vsSsbo);
+    }
+    glGetError(); // older drivers flag the ES 3.1 enum
+    const bool ssboOk = vsSsbo >= 1;
+
+    // Instanced attributes ride the fixed-function vertex fetch, so they go first;
+    // many Mali drivers report 0 vertex SSBO blocks, texture fetch works everywhere.
+    if (wanted == Backend::Attrib && attribOk) return Backend::Attrib;
+    if (wanted == Backend::Ssbo && ssboOk) return Backend::Ssbo;
+    if (wanted == Backend::Texture) return Backend::Texture;
+    if (attribOk) return Backend::Attrib;
+    if (ssboOk) return Backend::Ssbo;
+    return Backend::Texture;
+}
+
+void UiRenderer::setColorOutput(bool srgbTarget, ColorFormat format) {
+    m_srgbTarget = srgbTarget;
+    m_colorWanted = format;
+}
+bool UiRenderer::init(const Assets::Manager& am, Backend backend) {
+    return init(am.view("shaders/ui.vert"), am.view("shaders/ui.frag"), backend);
+}
+bool UiRenderer::init(const Assets::AssetView& vert, const Assets::AssetView& frag, Backend backend) {
+    return request(vert, frag, backend) && finishInit();
+}
+bool UiRenderer::request(const Assets::AssetView& vert, const Assets::AssetView& frag, Backend backend) {
+    if (vert.empty() || frag.empty()) {
+        logx::E("failed reading ui shaders from storage");
+        return false;
+    }
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &m_maxTex);
+    m_colorFormat = (m_colorWanted != ColorFormat::Auto) ? m_colorWanted :
+                    m_srgbTarget ? ColorFormat::LinearF16 : ColorFormat::Srgb8;
+    const bool f16 = m_colorFormat == ColorFormat::LinearF16;
+    m_instBytes  = f16 ? sizeof(UiInstGpuF16) : sizeof(UiInstGpu);
+    m_instTexels = (int)(m_instBytes / (4 * sizeof(uint32_t)));
+    logx::If("ui colors: {}{}", f16 ? "linear fp16" : "sRGB8", m_srgbTarget ? ", sRGB target" : "");
+    if (!m_shaders) {
+        m_ownShaders = std::make_unique<ShaderLibrary>();
+        m_shaders = m_ownShaders.get();
+    }
+    // kept until finishInit() in case the backend has to fall back
+    m_vs = vert;
+    m_fs = frag;
+    m_backend = pickBackend(backend);
+    requestPrograms(m_backend);
+    return true;
+}
+bool UiRenderer::programsReady() const {
+    for (const UiProg& p : m_progs) {
+        if (m_shaders && !m_shaders->ready(p.id)) return false;
+    }
+    return true;
+}
+bool UiRenderer::finishInit() {
+    if (m_vs.empty()) return false; // no request()
+    bool ok = false;
+    for (;;) {
+        if (resolvePrograms()) {
+            logx::If("instance backend: {}", backendName(m_backend));
+            ok = true;
+            break;
+        }
+        if (m_backend == Backend::Texture) break;
+        logx::Ef("instance backend {} failed, falling back", backendName(m_backend));
+        m_backend = (m_backend == Backend::Ssbo) ? Backend::Attrib : Backend::Texture;
+        requestPrograms(m_backend);
+    }
+    m_vs = {};
+    m_fs = {};
+    return ok;
 }
 void UiRenderer::shutdown() {
     if (m_quadVao) { glDeleteVertexArrays(1, &m_quadVao); m_quadVao = 0; }
@@ -205,30 +255,77 @@ void UiRenderer::shutdown() {
     m_objs.clear();
     destroyObj(m_frame);
     m_frame = UiObj{};
+    m_framePrev.clear();
+    m_frameLayers.clear();
+    destroyObj(m_merged);
+    m_merged = UiObj{};
+    m_mergedLayers.clear();
+    m_mergedLayoutDirty = true;
+    m_clipStack.clear();
+    m_states.assign(1, UiState{ClipRect::none(), 0});
+    m_xforms = XformTable{};
     destroyProgram();
 }
-bool UiRenderer::initProgram(const Assets::Manager& am) {
-    std::vector<char> vs = am.read("shaders/ui.vert");
-    std::vector<char> fs = am.read("shaders/ui.frag");
-    if (vs.empty() || fs.empty()) {
-        logx::E("failed reading ui shaders from storage");
-        return false;
+void UiRenderer::requestPrograms(Backend backend) {
+    // every stage of a program must share one GLSL ES version
+    const char* version = (backend == Backend::Ssbo) ? "310 es" : "300 es";
+    // ui.vert defaults to UI_INST_TEX when neither of the others is defined
+    const char* instDefine = (backend == Backend::Attrib) ? "UI_INST_ATTR" :
+                             (backend == Backend::Ssbo)   ? "UI_INST_SSBO" : nullptr;
+    static constexpr const char* kVariantDefine[] = { nullptr, "UI_VARIANT_SOLID", "UI_VARIANT_GRADIENT" };
+    static_assert(std::size(kVariantDefine) == (size_t)Variant::Count);
+
+    for (int v = 0; v < (int)Variant::Count; v++) {
+        std::vector<const char*> defines;
+        if (instDefine) defines.push_back(instDefine);
+        if (m_colorFormat == ColorFormat::LinearF16) defines.push_back("UI_COLOR_F16");
+        if (m_srgbTarget) defines.push_back("UI_SRGB_TARGET");
+        if (kVariantDefine[v]) defines.push_back(kVariantDefine[v]);
+        m_progs[v].id = m_shaders->request(m_vs.str(), m_fs.str(), version, defines);
     }
-
-    m_prog = linkProgram(reinterpret_cast<char*>(vs.data()),
-                         reinterpret_cast<char*>(fs.data()));
-    if (!m_prog) {
-        logx::E("failed linking program");
-        return false;
+}
+bool UiRenderer::resolvePrograms() {
+    // all variants were requested together; program() blocks only until
+    // each one has linked (not at all once programsReady())
+    for (int v = 0; v < (int)Variant::Count; v++) {
+        UiProg& p = m_progs[v];
+        p.prog = m_shaders->program(p.id);
+        if (!p.prog) {
+            // fast variants are optional; their instances fall back to General
+            logx::Ef("failed linking program (variant {})", v);
+            if (v == 0) { destroyProgram(); return false; }
+            m_shaders->release(p.id);
+            p = UiProg{};
+            continue;
+        }
+        p.uMVP      = glGetUniformLocation(p.prog, "uMVP");
+        p.uInst     = glGetUniformLocation(p.prog, "uInst");
+        p.uInst_W   = glGetUniformLocation(p.prog, "uInst_W");
+        p.uInstBase = glGetUniformLocation(p.prog, "uInstBase");
+
+        // state table on uniform buffer binding 0:  std140 vec4 clip[256]; uvec4 xf[64] (one byte per state)
+        // transform slots on binding 1:             std140 vec4 xform[2 * 256]
+        const GLuint stateBlock = glGetUniformBlockIndex(p.prog, "UiStateBlock");
+        const GLuint xformBlock = glGetUniformBlockIndex(p.prog, "UiXformBlock");
+        if (p.uMVP < 0 || stateBlock == GL_INVALID_INDEX || xformBlock == GL_INVALID_INDEX) {
+            if (v == 0) { destroyProgram(); return false; }
+            m_shaders->release(p.id);
+            p = UiProg{};
+            continue;
+        }
+        glUniformBlockBinding(p.prog, stateBlock, 0);
+        glUniformBlockBinding(p.prog, xformBlock, 1);
     }
 
-    m_uMVP     = glGetUniformLocation(m_prog, "uMVP");
-    m_uInstF   = glGetUniformLocation(m_prog, "uInstF");
-    m_uInstU   = glGetUniformLocation(m_prog, "uInstU");
-    m_uInstF_W = glGetUniformLocation(m_prog, "uInstF_W");
-    m_uInstU_W = glGetUniformLocation(m_prog, "uInstU_W");
-
-    if (m_uMVP < 0) return false;
+    glGenBuffers(1, &m_stateUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_stateUbo);
+    glBufferData(GL_UNIFORM_BUFFER, kMaxStates * (sizeof(ClipRect) + sizeof(uint32_t)), nullptr, GL_DYNAMIC_DRAW);
+    glGenBuffers(1, &m_xformUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_xformUbo);
+    glBufferData(GL_UNIFORM_BUFFER, XformTable::kMax * sizeof(Xform2D), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    m_stateDirty = true;
+    m_xforms.markAllDirty();
 
     // --- unit quad geometry ---
     static constexpr float kQuadCorners[8] = {
@@ -261,120 +358,616 @@ bool UiRenderer::initProgram(const Assets::Manager& am) {
     return true;
 }
 void UiRenderer::destroyProgram() {
-    if (m_prog) {
-        glDeleteProgram(m_prog);
-        m_prog = 0;
+    for (auto& p : m_progs) {
+        if (m_shaders) m_shaders->release(p.id);
+        p = UiProg{};
     }
-    m_uMVP = -1;
-    m_uInstF = m_uInstU = m_uInstF_W = m_uInstU_W = -1;
+    if (m_ownShaders) m_ownShaders->shutdown();
+    if (m_stateUbo) { glDeleteBuffers(1, &m_stateUbo); m_stateUbo = 0; }
+    if (m_xformUbo) { glDeleteBuffers(1, &m_xformUbo); m_xformUbo = 0; }
 }
 
-void UiRenderer::uploadObj(UiObj& o, GLenum /*usage*/) {
+void UiRenderer::setupAttribVao(UiObj& o) {
+    glGenVertexArrays(1, &o.vao);
+    glBindVertexArray(o.vao);
+
+    // shared unit quad
+    glBindBuffer(GL_ARRAY_BUFFER, m_quadVbo);
+    glEnableVertexAttribArray(0); // aCorner
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_quadEbo);
+
+    // per-instance UiInstGpu, one step per instance
+    glBindBuffer(GL_ARRAY_BUFFER, o.buf);
+    for (GLuint loc = 1; loc <= 6; loc++) {
+        glEnableVertexAttribArray(loc);
+        glVertexAttribDivisor(loc, 1);
+    }
+    pointInstAttribs(0);
+    o.attribBase = 0;
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+// Point the bound VAO's instance attributes at instance `first` of the bound
+// GL_ARRAY_BUFFER (ES 3.0 has no base-instance draws).
+void UiRenderer::pointInstAttribs(size_t first) const {
+    const GLsizei stride = (GLsizei)m_instBytes;
+    const size_t base = first * m_instBytes;
+    // aPos: fixed-point center + shape/feather, decoded in ui.vert
+    glVertexAttribIPointer(1, 2, GL_UNSIGNED_INT, stride, (void*)(base + offsetof(UiInstGpu, cxShape)));
+    // aHalfRad: hx hy radius stroke as fp16
+    glVertexAttribPointer(2, 4, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(UiInstGpu, hx)));
+    // aTL..aBL: packed RGBA8 -> normalized vec4, or linear fp16 RGBA
+    if (m_colorFormat == ColorFormat::LinearF16) {
+        for (GLuint c = 0; c < 4; c++) {
+            glVertexAttribPointer(3 + c, 4, GL_HALF_FLOAT, GL_FALSE, stride,
+                                  (void*)(base + offsetof(UiInstGpuF16, tl) + c * 4 * sizeof(uint16_t)));
+        }
+        return;
+    }
+    for (GLuint c = 0; c < 4; c++) {
+        glVertexAttribPointer(3 + c, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                              (void*)(base + offsetof(UiInstGpu, tl) + c * sizeof(uint32_t)));
+    }
+}
+void UiRenderer::markDirty(UiObj& o, size_t lo, size_t hi) {
+    o.gpuDirty = true;
+    o.changed = true;
+    o.runsDirty = true;
+    if (lo >= hi) return;
+    o.dirtyLo = std::min(o.dirtyLo, lo);
+    o.dirtyHi = std::max(o.dirtyHi, hi);
+
+    if (o.dirtyBits.size() * 64 < hi) o.dirtyBits.resize((hi + 63) / 64, 0);
+    for (size_t i = lo; i < hi; ) {
+        const size_t w = i / 64, b = i % 64;
+        const size_t n = std::min<size_t>(64 - b, hi - i);
+        o.dirtyBits[w] |= (n == 64) ? ~0ull : (((1ull << n) - 1) << b);
+        i += n;
+    }
+}
+void UiRenderer::clearDirty(UiObj& o) {
+    if (o.dirtyLo < o.dirtyHi) {
+        std::fill(o.dirtyBits.begin() + o.dirtyLo / 64,
+                  o.dirtyBits.begin() + std::min(o.dirtyBits.size(), (o.dirtyHi + 63) / 64), 0);
+    }
+    o.dirtyLo = SIZE_MAX;
+    o.dirtyHi = 0;
+}
+void UiRenderer::takeDirtyRuns(UiObj& o, std::vector<DirtyRun>& out) {
+    out.clear();
+    const size_t hi = std::min(o.dirtyHi, o.inst.size());
+    for (size_t w = o.dirtyLo / 64; w * 64 < hi; w++) {
+        uint64_t bits = o.dirtyBits[w];
+        while (bits) {
+            const size_t i = w * 64 + (size_t)std::countr_zero(bits);
+            bits &= bits - 1;
+            if (i >= hi) break;
+            // one upload call beats several tiny ones for short gaps
+            if (!out.empty() && i - out.back().hi < kDirtyGap) out.back().hi = i + 1;
+            else out.push_back({i, i + 1});
+        }
+    }
+    clearDirty(o);
+}
+bool UiRenderer::reserveObj(UiObj& o, size_t count, GLenum usage) {
+    if (count <= o.capInst && (o.tex || o.buf)) return false;
+
+    // headroom so appending a few rects doesn't re-specify storage every time
+    const size_t cap = std::max({count, o.capInst * 2, kMinInstCap});
+    switch (m_backend) {
+        case Backend::Attrib:
+        case Backend::Ssbo: {
+            const GLenum target = (m_backend == Backend::Attrib) ? GL_ARRAY_BUFFER : GL_SHADER_STORAGE_BUFFER;
+            if (!o.buf) glGenBuffers(1, &o.buf);
+            if (m_backend == Backend::Attrib && !o.vao) setupAttribVao(o);
+            glBindBuffer(target, o.buf);
+            glBufferData(target, (GLsizeiptr)(cap * m_instBytes), nullptr, usage);
+            glBindBuffer(target, 0);
+            break;
+        }
+        case Backend::Texture:
+        case Backend::Auto:
+            // integer format: the packed bytes go up as-is, no driver conversion
+            chooseDims((int)cap * m_instTexels, m_maxTex, o.texW, o.texH);
+            allocInstTex(o.tex, o.texW, o.texH, GL_RGBA32UI, GL_RGBA_INTEGER, GL_UNSIGNED_INT);
+            break;
+    }
+    o.capInst = cap;
+    return true;
+}
+void UiRenderer::uploadObj(UiObj& o, GLenum usage) {
     if (!o.gpuDirty) return;
     o.gpuDirty = false;
 
-    o.instanceCount = (GLsizei)o.inst.size();
-    if (!o.instanceCount) return;
+    const size_t count = o.inst.size();
+    o.instanceCount = (GLsizei)count;
+    if (!count) { clearDirty(o); return; }
+
+    // new storage has no valid contents: send everything
+    if (reserveObj(o, count, usage)) {
+        clearDirty(o);
+        uploadRange(o, 0, count);
+        return;
+    }
+    takeDirtyRuns(o, m_dirtyRuns);
+    for (const DirtyRun& r : m_dirtyRuns) uploadRange(o, r.lo, r.hi);
+}
+void UiRenderer::uploadRange(UiObj& o, size_t lo, size_t hi) {
+    if (lo >= hi) return;
+    if (m_prof) m_prof->count(ProfCounter::BytesUploaded, (hi - lo) * m_instBytes);
+
+    const void* packed;
+    if (m_colorFormat == ColorFormat::LinearF16) {
+        m_stageF16.resize(hi - lo);
+        packInstances(o.inst.data() + lo, hi - lo, m_stageF16.data());
+        packed = m_stageF16.data();
+    } else {
+        m_stage.resize(hi - lo);
+        packInstances(o.inst.data() + lo, hi - lo, m_stage.data());
+        packed = m_stage.data();
+    }
+
+    switch (m_backend) {
+        case Backend::Attrib:
+        case Backend::Ssbo: {
+            const GLenum target = (m_backend == Backend::Attrib) ? GL_ARRAY_BUFFER : GL_SHADER_STORAGE_BUFFER;
+            glBindBuffer(target, o.buf);
+            glBufferSubData(target, (GLintptr)(lo * m_instBytes),
+                            (GLsizeiptr)((hi - lo) * m_instBytes), packed);
+            glBindBuffer(target, 0);
+            break;
+        }
+        case Backend::Texture:
+        case Backend::Auto:
+            // 2 (Srgb8) or 3 (LinearF16) RGBA32UI texels per instance
+            glBindTexture(GL_TEXTURE_2D, o.tex);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            uploadTexelRange(o.texW, (int)lo * m_instTexels, (int)hi * m_instTexels, GL_RGBA_INTEGER, GL_UNSIGNED_INT,
+                             4 * sizeof(uint32_t), packed);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            break;
+    }
+}
+void UiRenderer::uploadFrame() {
+    if (!m_frame.gpuDirty) return;
+    ProfScope ps(m_prof, ProfPhase::UiUpload);
+    m_frame.gpuDirty = false;
+    clearDirty(m_frame); // diffed against last frame below instead
+
+    const size_t count = m_frame.inst.size();
+    m_frame.instanceCount = (GLsizei)count;
+    m_frameStats.lastSent = 0;
+
+    const bool fresh = count && reserveObj(m_frame, count, GL_DYNAMIC_DRAW);
+    if (!count || (!fresh && count == m_framePrev.size() &&
+                   std::memcmp(m_frame.inst.data(), m_framePrev.data(), count * sizeof(UiRectInst)) == 0)) {
+        m_frameStats.last = FrameUpload::Skipped;
+        m_frameStats.skipped++;
+        if (!count) {
+            truncateFrameBounds(0);
+            m_framePrev.clear();
+        }
+        return;
+    }
+    truncateFrameBounds(count);
+
+    // Compare against last frame in kFrameChunk-instance chunks and upload each
+    // run of differing chunks. Storage that was just (re)allocated, and anything
+    // past the previous frame's end, has no valid contents and always goes up.
+    const size_t same = fresh ? 0 : std::min(count, m_framePrev.size());
+    size_t runLo = SIZE_MAX, runs = 0;
+    for (size_t c = 0; c < count; c += kFrameChunk) {
+        const size_t e = std::min(c + kFrameChunk, count);
+        const bool diff = e > same ||
+            std::memcmp(m_frame.inst.data() + c, m_framePrev.data() + c, (e - c) * sizeof(UiRectInst)) != 0;
+        if (diff) {
+            damageFrame(c, e);
+            if (runLo == SIZE_MAX) runLo = c;
+            continue;
+        }
+        if (runLo != SIZE_MAX) {
+            uploadRange(m_frame, runLo, c);
+            m_frameStats.lastSent += c - runLo;
+            runLo = SIZE_MAX;
+            runs++;
+        }
+    }
+    if (runLo != SIZE_MAX) {
+        uploadRange(m_frame, runLo, count);
+        m_frameStats.lastSent += count - runLo;
+        runs++;
+    }
+
+    if (m_frameStats.lastSent == count) {
+        m_frameStats.last = FrameUpload::Full;
+        m_frameStats.full++;
+    } else if (runs) {
+        m_frameStats.last = FrameUpload::Partial;
+        m_frameStats.partial++;
+    } else {
+        m_frameStats.last = FrameUpload::Skipped;
+        m_frameStats.skipped++;
+    }
+    m_frameStats.instSent += m_frameStats.lastSent;
+    m_framePrev.assign(m_frame.inst.begin(), m_frame.inst.end());
+}
+UiRenderer::Variant UiRenderer::classify(const UiRectInst& in) const {
+    if (in.shape != UiShape::Rect || in.radius > 0.0f) return Variant::General;
+    const Xform2D& m = m_xforms.get(m_states[in.state].xf);
+    if (m.a != 1.0f || m.b != 0.0f || m.c != 0.0f || m.d != 1.0f) return Variant::General;
+
+    // With every edge on the pixel grid each covered pixel center is >= 0.5 px
+    // inside, where the SDF path yields full coverage anyway; dropping it is exact.
+    auto onGrid = [](float v) { return std::abs(v - std::round(v)) < (1.0f / 32.0f); };
+    const float x0 = in.cx - in.hx + m.tx, x1 = in.cx + in.hx + m.tx;
+    const float y0 = in.cy - in.hy + m.ty, y1 = in.cy + in.hy + m.ty;
+    if (!onGrid(x0) || !onGrid(x1) || !onGrid(y0) || !onGrid(y1)) return Variant::General;
+
+    const bool solid = in.tl == in.tr && in.tl == in.br && in.tl == in.bl;
+    const Variant v = solid ? Variant::Solid : Variant::Gradient;
+    return m_progs[(int)v].prog ? v : Variant::General;
+}
+void UiRenderer::buildRuns(UiObj& o) {
+    if (!o.runsDirty && o.runsGen == m_stateGen) return;
+    o.runsDirty = false;
+    o.runsGen = m_stateGen;
+    o.runs.clear();
+
+    // consecutive instances of one variant, with the area a fast run would save
+    struct Span { Variant v; uint32_t first, count; float area; };
+    static thread_local std::vector<Span> spans;
+    spans.clear();
+    const uint32_t n = (uint32_t)std::min(o.inst.size(), (size_t)o.instanceCount);
+    for (uint32_t i = 0; i < n; i++) {
+        const UiRectInst& in = o.inst[i];
+        const Variant v = classify(in);
+        // empty instances (removed elements) draw nothing under any variant
+        const bool empty = in.hx == 0.0f && in.hy == 0.0f;
+        if (!spans.empty() && (spans.back().v == v || empty)) {
+            spans.back().count++;
+        } else {
+            spans.push_back({v, i, 1, 0.0f});
+        }
+        spans.back().area += 4.0f * in.hx * in.hy;
+    }
 
-    // Prefer GL_RGBA16F for broad ES3 support
-    uploadInstF(o.inst, o.texF, o.wF, o.hF, GL_RGBA16F);
-    uploadInstU(o.inst, o.texU, o.wU, o.hU);
+    // small fast spans would only add draws; General renders them identically
+    for (const Span& sp : spans) {
+        const Variant v = (sp.v != Variant::General && sp.area < kVariantMinArea) ? Variant::General : sp.v;
+        if (!o.runs.empty() && o.runs.back().variant == v) {
+            o.runs.back().count += sp.count;
+        } else {
+            o.runs.push_back({v, sp.first, sp.count});
+        }
+    }
 }
-void UiRenderer::drawObj(const UiObj& o) {
+const UiRenderer::UiProg& UiRenderer::useVariant(Variant v, DrawList& list) {
+    UiProg& p = m_progs[(int)v];
+    list.state().useProgram(p.prog);
+    m_shaders->setMvp(p.id, p.uMVP, list.mvp());
+    return p;
+}
+void UiRenderer::drawCmd(void* ctx, uint32_t store, uint32_t lo, uint32_t hi, DrawList& list) {
+    auto* self = static_cast<UiRenderer*>(ctx);
+    UiObj& o = (store == 0) ? self->m_frame : (store == 1) ? self->m_merged : self->m_objs[store - 2];
+    self->drawObj(o, lo, hi, list);
+}
+// Draws instances [lo, hi) of o, split where the fragment variant changes.
+void UiRenderer::drawObj(UiObj& o, size_t lo, size_t hi, DrawList& list) {
     if (!o.alive) return;
-    if (!o.instanceCount) return;
+    hi = std::min(hi, (size_t)o.instanceCount);
+    if (lo >= hi) return;
 
-    glBindVertexArray(m_quadVao);
+    buildRuns(o);
 
-    // bind float instance texture to unit 0
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, o.texF);
+    const bool texPath = m_backend != Backend::Attrib && m_backend != Backend::Ssbo;
+    if (m_backend == Backend::Attrib) {
+        glBindVertexArray(o.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, o.buf);
+    } else {
+        glBindVertexArray(m_quadVao);
+    }
+    if (m_backend == Backend::Ssbo) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, o.buf);
+    }
+    if (texPath) {
+        // instance texture on unit 0
+        list.state().bindTexture(o.tex);
+    }
 
-    // bind uint instance texture to unit 1
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, o.texU);
+    for (const auto& r : o.runs) {
+        const size_t first = std::max(lo, (size_t)r.first);
+        const size_t last  = std::min(hi, (size_t)r.first + r.count);
+        if (first >= last) continue;
+
+        const UiProg& p = useVariant(r.variant, list);
+        if (m_backend == Backend::Attrib) {
+            if (o.attribBase != first) {
+                pointInstAttribs(first);
+                o.attribBase = first;
+            }
+        } else {
+            glUniform1i(p.uInstBase, (GLint)first);
+        }
+        if (texPath) {
+            glUniform1i(p.uInst, 0);
+            glUniform1i(p.uInst_W, o.texW);
+        }
+        glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, (void*)0, (GLsizei)(last - first));
+        if (m_prof) m_prof->count(ProfCounter::DrawCalls, 1);
+    }
 
-    glUniform1i(m_uInstF, 0);
-    glUniform1i(m_uInstU, 1);
-    glUniform1i(m_uInstF_W, o.wF);
-    glUniform1i(m_uInstU_W, o.wU);
+    // optional hygiene (the instance texture stays bound; GpuState tracks it)
+    if (m_backend == Backend::Attrib) glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (m_backend == Backend::Ssbo) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+}
+void UiRenderer::setMerged(bool on) {
+    if (on == m_mergedMode) return;
+    m_mergedMode = on;
+    if (on) {
+        m_mergedLayoutDirty = true;
+        return;
+    }
+    // per-object storage went stale while merged; resend everything
+    for (auto& o : m_objs) {
+        if (o.alive) markDirty(o, 0, o.inst.size());
+    }
+}
+ClipRect UiRenderer::instBounds(const UiRectInst& in) {
+    // AA fringe plus a pixel of slack; segments may be rotated, so pad both axes by the width
+    const float pad = in.feather + 1.0f + ((in.shape == UiShape::Segment) ? 0.5f * in.stroke : 0.0f);
+    const float ex = std::abs(in.hx) + pad, ey = std::abs(in.hy) + pad;
+    return {in.cx - ex, in.cy - ey, in.cx + ex, in.cy + ey};
+}
+void UiRenderer::damageObj(UiObj& o) {
+    if (o.changed) {
+        Damage u;
+        for (const auto& in : o.inst) u.add(instBounds(in));
+        o.local = u.bounds();
+    }
+    const Xform2D& xf = m_xforms.get(o.xf);
+    if (!o.changed && std::memcmp(&xf, &o.drawnXf, sizeof(Xform2D)) == 0) return;
+    o.changed = false;
+
+    ClipRect now{};
+    if (!o.inst.empty() && xf.opacity > 0.0f) {
+        now = o.local;
+        xf.applyBounds(now.x0, now.y0, now.x1, now.y1);
+    }
+    if (m_damage) {
+        m_damage->add(o.drawn);
+        m_damage->add(now);
+    }
+    o.drawn = now;
+    o.drawnXf = xf;
+}
+ClipRect UiRenderer::frameInstBounds(const UiRectInst& in) const {
+    const UiState& st = m_states[in.state];
+    const Xform2D& xf = m_xforms.get(st.xf);
+    if (xf.opacity <= 0.0f) return {};
+    ClipRect r = instBounds(in);
+    xf.applyBounds(r.x0, r.y0, r.x1, r.y1);
+    return r.intersect(st.clip);
+}
+// Old and new bounds of the frame instances in [lo, hi) that differ from the
+// previous frame's; a static full-screen background costs nothing while a
+// selection rect moves over it.
+void UiRenderer::damageFrame(size_t lo, size_t hi) {
+    for (size_t i = lo; i < hi; i++) {
+        const UiRectInst& in = m_frame.inst[i];
+        if (i < m_framePrev.size() && std::memcmp(&in, &m_framePrev[i], sizeof(UiRectInst)) == 0) continue;
+        ClipRect& b = m_frameBounds[i];
+        if (m_damage) m_damage->add(b);
+        b = frameInstBounds(in);
+        if (m_damage) m_damage->add(b);
+    }
+}
+// Instances past the new end are gone: damage what they covered.
+void UiRenderer::truncateFrameBounds(size_t count) {
+    if (m_damage) {
+        for (size_t i = count; i < m_frameBounds.size(); i++) m_damage->add(m_frameBounds[i]);
+    }
+    m_frameBounds.resize(count); // new slots start empty
+}
+bool UiRenderer::needsRedraw() const {
+    if (m_xforms.dirty()) return true;
+    for (const auto& o : m_objs) {
+        if (o.alive && o.changed) return true;
+    }
+    return false;
+}
+void UiRenderer::mergeObjects() {
+    if (!m_mergedLayoutDirty) {
+        for (const auto& o : m_objs) {
+            if (o.alive && o.inst.size() != o.mergedCount) { m_mergedLayoutDirty = true; break; }
+        }
+    }
 
-    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, (void*)0, o.instanceCount);
+    if (m_mergedLayoutDirty) {
+        // Re-lay out every live object back to back, by layer, then m_objs (draw) order.
+        m_mergedLayoutDirty = false;
+        m_merged.inst.clear();
+        m_mergedLayers.clear();
+        std::vector<size_t> order;
+        for (size_t i = 0; i < m_objs.size(); i++) {
+            if (m_objs[i].alive) order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&](size_t a, size_t b) { return m_objs[a].layer < m_objs[b].layer; });
+        for (size_t i : order) {
+            UiObj& o = m_objs[i];
+            o.mergedBase  = m_merged.inst.size();
+            o.mergedCount = o.inst.size();
+            m_merged.inst.insert(m_merged.inst.end(), o.inst.begin(), o.inst.end());
+            o.gpuDirty = false;
+            clearDirty(o);
+            if (m_mergedLayers.empty() || m_mergedLayers.back().layer != o.layer) {
+                m_mergedLayers.push_back({o.layer, (uint32_t)o.mergedBase, (uint32_t)o.mergedBase});
+            }
+            m_mergedLayers.back().hi = (uint32_t)m_merged.inst.size();
+        }
+        markDirty(m_merged, 0, m_merged.inst.size());
+        return;
+    }
 
-    // optional hygiene
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // Same layout: patch only the dirty runs into the shared store.
+    for (auto& o : m_objs) {
+        if (!o.alive || !o.gpuDirty) continue;
+        o.gpuDirty = false;
+        takeDirtyRuns(o, m_dirtyRuns);
+        for (const DirtyRun& r : m_dirtyRuns) {
+            std::copy(o.inst.begin() + r.lo, o.inst.begin() + r.hi, m_merged.inst.begin() + o.mergedBase + r.lo);
+            markDirty(m_merged, o.mergedBase + r.lo, o.mergedBase + r.hi);
+        }
+    }
 }
 void UiRenderer::updateObjects() {
+    ProfScope ps(m_prof, ProfPhase::UiUpload);
+    if (m_mergedMode) {
+        mergeObjects();
+        uploadObj(m_merged, GL_STATIC_DRAW);
+        return;
+    }
     for (auto& o : m_objs) {
         if (!o.alive) continue;
         uploadObj(o, GL_STATIC_DRAW);
     }
 }
 void UiRenderer::drawObjects(const float* mvp4x4) {
-    if (!m_prog || m_uMVP < 0) return;
+    if (!m_progs[0].prog) return;
+    m_list.begin(mvp4x4);
+    submitObjects(m_list);
+    m_list.flush();
+}
+void UiRenderer::submitObjects(DrawList& list) {
+    if (!m_progs[0].prog) return;
 
+    for (auto& o : m_objs) {
+        if (o.alive) damageObj(o);
+    }
     // make sure dirty objects are uploaded
     updateObjects();
-
-    glUseProgram(m_prog);
-    glUniformMatrix4fv(m_uMVP, 1, GL_FALSE, mvp4x4);
-
-    for (const auto& o : m_objs) drawObj(o);
-
-    glBindVertexArray(0);
+    uploadStates();
+
+    // Instances of one draw are rasterized in instance order, so the merged
+    // store only splits per layer and where the fragment variant changes (see
+    // buildRuns). The key carries no texture: objects of one layer overlap and
+    // must keep their order.
+    const GLuint prog = m_progs[0].prog;
+    if (m_mergedMode) {
+        for (const auto& lr : m_mergedLayers) {
+            list.submit(lr.layer, kDepthObjects, prog, 0, BlendMode::Premultiplied, &drawCmd, this, 1, lr.lo, lr.hi);
+        }
+        return;
+    }
+    for (size_t i = 0; i < m_objs.size(); i++) {
+        const UiObj& o = m_objs[i];
+        if (!o.alive || !o.instanceCount) continue;
+        list.submit(o.layer, kDepthObjects, prog, 0, BlendMode::Premultiplied, &drawCmd, this,
+                    (uint32_t)(2 + i), 0, (uint32_t)o.instanceCount);
+    }
+}
+void UiRenderer::submit(DrawList& list) {
+    submitFrame(list);
+    submitObjects(list);
 }
 
 void UiRenderer::destroyObj(UiObj& o) {
-    destroyTex(o.texF);
-    destroyTex(o.texU);
+    destroyTex(o.tex);
+    if (o.vao) { glDeleteVertexArrays(1, &o.vao); o.vao = 0; }
+    if (o.buf) { glDeleteBuffers(1, &o.buf); o.buf = 0; }
     o.inst.clear();
     o.instanceCount = 0;
+    o.capInst = 0;
     o.alive = false;
 }
 void UiRenderer::objClear(UiObj& o) {
+    o.changed = true;
     o.inst.clear();
     o.instanceCount = 0;
     o.gpuDirty = true;
+    o.runsDirty = true;
+    clearDirty(o);
+    o.elemIndex.clear();
+    o.instElem.clear();
+    o.holes = 0;
 }
-void UiRenderer::objRectFilled(UiObj& o, float x, float y, float w, float h, const UiColors& cc, float radius, float feather) {
-    pushRectInst(o.inst, UiQuad{x, y, x + w, y + h, cc, radius, feather});
-    o.gpuDirty = true;
+UiRenderer::Elem UiRenderer::objPush(UiObj& o, const UiRectInst& inst) {
+    const ClipRect clip = m_clipStack.top();
+    if (&o == &m_frame && m_clipStack.active()) {
+        // conservative bounds; segments may be rotated, so pad both axes by the width
+        const float pad = (inst.shape == UiShape::Segment) ? 0.5f * inst.stroke : 0.0f;
+        const float ex = std::abs(inst.hx) + pad, ey = std::abs(inst.hy) + pad;
+        if (!clip.overlaps(inst.cx - ex, inst.cy - ey, inst.cx + ex, inst.cy + ey)) return Elem{};
+    }
+    const uint8_t state = stateIndex(clip, o.xf);
+    o.inst.push_back(inst);
+    o.inst.back().state = state;
+    markDirty(o, o.inst.size() - 1, o.inst.size());
+
+    if (&o == &m_frame) {
+        const uint32_t i = (uint32_t)o.inst.size() - 1;
+        if (m_frameLayers.empty() || m_frameLayers.back().layer != m_frameLayerCur) {
+            m_frameLayers.push_back({m_frameLayerCur, i, i});
+        }
+        m_frameLayers.back().hi = i + 1;
+        return Elem{};
+    }
+
+    // ids are handed out in push order and not reused until objClear
+    const int id = (int)o.elemIndex.size();
+    o.elemIndex.push_back((int32_t)o.inst.size() - 1);
+    o.instElem.push_back(id);
+    return Elem{id};
 }
-void UiRenderer::objRectOutline(UiObj& o, float x, float y, float w, float h, float t, const UiColors& cc) {
-    // top
-    objRectFilled(o, x, y, w, t, cc);
-    // bottom
-    objRectFilled(o, x, y + h - t, w, t, cc);
-    // left
-    objRectFilled(o, x, y + t, t, h - 2*t, cc);
-    // right
-    objRectFilled(o, x + w - t, y + t, t, h - 2*t, cc);
-}
-void UiRenderer::objLine(UiObj& o, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc) {
-    // Represent as a rectangle oriented along the line.
-    // Minimal implementation: axis-aligned only (if you want full rotated lines, you need a little math).
-    // Here: if not axis-aligned, fall back to bounding-box thickness.
-    float minx = (x0 < x1) ? x0 : x1;
-    float maxx = (x0 > x1) ? x0 : x1;
-    float miny = (y0 < y1) ? y0 : y1;
-    float maxy = (y0 > y1) ? y0 : y1;
-
-    float w = (maxx - minx);
-    float hh = (maxy - miny);
-
-    if (w < 1e-4f) {
-        // vertical
-        objRectFilled(o, minx - thickness * 0.5f, miny, thickness, hh, cc);
-    } else if (hh < 1e-4f) {
-        // horizontal
-        objRectFilled(o, minx, miny - thickness * 0.5f, w, thickness, cc);
-    } else {
-        // diagonal fallback (not ideal)
-        objRectFilled(o, minx, miny, w, hh, cc);
+UiRenderer::Elem UiRenderer::objRectFilled(UiObj& o, float x, float y, float w, float h, const UiColors& cc, float radius, float feather) {
+    return objPush(o, makeRectInst(UiQuad{x, y, x + w, y + h, cc, radius, feather}));
+}
+UiRenderer::Elem UiRenderer::objRectOutline(UiObj& o, float x, float y, float w, float h, float t, const UiColors& cc, float radius) {
+    // one stroke instance; follows the rounded corners
+    return objPush(o, makeRectInst(UiQuad{x, y, x + w, y + h, cc, radius, 1.0f}, UiShape::RectStroke, t));
+}
+UiRenderer::Elem UiRenderer::objLine(UiObj& o, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc) {
+    // butt caps: the box spans exactly p0..p1, rotated along the line in ui.vert
+    return objPush(o, makeInst(UiShape::Segment, 0.5f*(x0 + x1), 0.5f*(y0 + y1), 0.5f*(x1 - x0), 0.5f*(y1 - y0),
+                               cc, 0.0f, thickness, 1.0f));
+}
+UiRenderer::Elem UiRenderer::objCapsule(UiObj& o, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc) {
+    // round caps: extend the half axis by the cap radius and round it fully
+    const float r = 0.5f * thickness;
+    float ax, ay;
+    capsuleAxis(x0, y0, x1, y1, r, ax, ay);
+    return objPush(o, makeInst(UiShape::Segment, 0.5f*(x0 + x1), 0.5f*(y0 + y1), ax, ay, cc, r, thickness, 1.0f));
+}
+UiRenderer::Elem UiRenderer::objCircle(UiObj& o, float cx, float cy, float r, const UiColors& cc, float feather) {
+    return objPush(o, makeInst(UiShape::Circle, cx, cy, r, r, cc, r, 0.0f, feather));
+}
+UiRenderer::Elem UiRenderer::objRing(UiObj& o, float cx, float cy, float r, float thickness, const UiColors& cc, float feather) {
+    return objPush(o, makeInst(UiShape::Ring, cx, cy, r, r, cc, r, thickness, feather));
+}
+
+int UiRenderer::elemIndex(const UiObj& o, Elem e) {
+    if (e.id < 0 || e.id >= (int)o.elemIndex.size()) return -1;
+    return o.elemIndex[e.id];
+}
+void UiRenderer::compactObj(UiObj& o) {
+    // squeeze out the holes, keeping draw order; ids stay valid through elemIndex
+    size_t n = 0;
+    for (size_t i = 0; i < o.inst.size(); i++) {
+        const int32_t id = o.instElem[i];
+        if (id < 0) continue;
+        o.inst[n] = o.inst[i];
+        o.instElem[n] = id;
+        o.elemIndex[id] = (int32_t)n;
+        n++;
     }
+    o.inst.resize(n);
+    o.instElem.resize(n);
+    o.holes = 0;
+    // the size change re-lays out the merged store; per-object storage resends
+    markDirty(o, 0, n);
 }
 
 void UiRenderer::objSetUiColors(UiObj& o, UiO opts, const UiColors& cc) {
@@ -396,7 +989,7 @@ void UiRenderer::objSetUiColors(UiObj& o, UiO opts, const UiColors& cc) {
         if (br) inst.br = pcc.br;
         if (bl) inst.bl = pcc.bl;
     }
-    o.gpuDirty = true;
+    markDirty(o, 0, o.inst.size());
 }
 void UiRenderer::objRectOpts(UiObj& o, UiO opts, optarg_t arg) {
     using namespace bitmask;
@@ -425,33 +1018,108 @@ UiRenderer::Handle UiRenderer::createObj() {
             m_objs[i] = UiObj{};
             m_objs[i].alive = true;
             m_objs[i].gpuDirty = true;
+            m_mergedLayoutDirty = true;
             return Handle{i};
         }
     }
 
+    m_mergedLayoutDirty = true;
     m_objs.emplace_back();
     UiObj& o = m_objs.back();
     return Handle{(int)m_objs.size() - 1};
 }
 void UiRenderer::destroyObj(Handle h) {
     UiObj* o = get(h);
-    if (o) destroyObj(*o);
+    if (!o) return;
+    if (m_damage) m_damage->add(o->drawn);
+    destroyObj(*o);
+    m_mergedLayoutDirty = true;
 }
 void UiRenderer::objClear(Handle h) { 
     UiObj* o = get(h);
     if (o) objClear(*o);
 }
-void UiRenderer::objRectFilled(Handle hdl, float x, float y, float w, float h, const UiColors& cc, float radius, float feather) {
+UiRenderer::Elem UiRenderer::objRectFilled(Handle hdl, float x, float y, float w, float h, const UiColors& cc, float radius, float feather) {
+    UiObj* o = get(hdl);
+    return o ? objRectFilled(*o, x, y, w, h, cc, radius, feather) : Elem{};
+}
+UiRenderer::Elem UiRenderer::objRectOutline(Handle hdl, float x, float y, float w, float h, float t, const UiColors& cc, float radius) {
     UiObj* o = get(hdl);
-    if (o) objRectFilled(*o, x, y, w, h, cc, radius, feather);
+    return o ? objRectOutline(*o, x, y, w, h, t, cc, radius) : Elem{};
 }
-void UiRenderer::objRectOutline(Handle hdl, float x, float y, float w, float h, float t, const UiColors& cc) {
+UiRenderer::Elem UiRenderer::objLine(Handle hdl, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc) {
     UiObj* o = get(hdl);
-    if (o) objRectOutline(*o, x, y, w, h, t, cc);
+    return o ? objLine(*o, x0, y0, x1, y1, thickness, cc) : Elem{};
 }
-void UiRenderer::objLine(Handle hdl, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc) {
+UiRenderer::Elem UiRenderer::objCapsule(Handle hdl, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc) {
     UiObj* o = get(hdl);
-    if (o) objLine(*o, x0, y0, x1, y1, thickness, cc);
+    return o ? objCapsule(*o, x0, y0, x1, y1, thickness, cc) : Elem{};
+}
+UiRenderer::Elem UiRenderer::objCircle(Handle hdl, float cx, float cy, float r, const UiColors& cc, float feather) {
+    UiObj* o = get(hdl);
+    return o ? objCircle(*o, cx, cy, r, cc, feather) : Elem{};
+}
+UiRenderer::Elem UiRenderer::objRing(Handle hdl, float cx, float cy, float r, float thickness, const UiColors& cc, float feather) {
+    UiObj* o = get(hdl);
+    return o ? objRing(*o, cx, cy, r, thickness, cc, feather) : Elem{};
+}
+void UiRenderer::objSetRect(Handle hdl, Elem e, float x, float y, float w, float h) {
+    UiObj* o = get(hdl);
+    const int i = o ? elemIndex(*o, e) : -1;
+    if (i < 0) return;
+    UiRectInst& in = o->inst[i];
+
+    const float x0 = std::min(x, x + w), x1 = std::max(x, x + w);
+    const float y0 = std::min(y, y + h), y1 = std::max(y, y + h);
+    switch (in.shape) {
+        case UiShape::Rect:
+        case UiShape::RectStroke:
+            in.cx = 0.5f*(x0 + x1); in.cy = 0.5f*(y0 + y1);
+            in.hx = 0.5f*(x1 - x0); in.hy = 0.5f*(y1 - y0);
+            break;
+        case UiShape::Circle:
+        case UiShape::Ring: {
+            const float r = 0.5f * std::min(x1 - x0, y1 - y0);
+            in.cx = 0.5f*(x0 + x1); in.cy = 0.5f*(y0 + y1);
+            in.hx = in.hy = in.radius = r;
+            break;
+        }
+        case UiShape::Segment:
+            // the signed extent is the direction here
+            in.cx = x + 0.5f*w; in.cy = y + 0.5f*h;
+            if (in.radius > 0.0f) {
+                capsuleAxis(x, y, x + w, y + h, in.radius, in.hx, in.hy);
+            } else {
+                in.hx = 0.5f*w; in.hy = 0.5f*h;
+            }
+            break;
+    }
+    markDirty(*o, (size_t)i, (size_t)i + 1);
+}
+void UiRenderer::objSetColors(Handle hdl, Elem e, const UiColors& cc) {
+    UiObj* o = get(hdl);
+    const int i = o ? elemIndex(*o, e) : -1;
+    if (i < 0) return;
+    const auto pcc = cc.pack();
+    UiRectInst& in = o->inst[i];
+    in.tl = pcc.tl; in.tr = pcc.tr; in.br = pcc.br; in.bl = pcc.bl;
+    markDirty(*o, (size_t)i, (size_t)i + 1);
+}
+void UiRenderer::objRemove(Handle hdl, Elem e) {
+    UiObj* o = get(hdl);
+    const int i = o ? elemIndex(*o, e) : -1;
+    if (i < 0) return;
+
+    // leave an empty instance so nothing after it moves (and nothing else re-uploads)
+    UiRectInst& in = o->inst[i];
+    in.hx = in.hy = in.radius = in.stroke = 0.0f;
+    in.tl = in.tr = in.br = in.bl = 0;
+    o->elemIndex[e.id] = -1;
+    o->instElem[i] = -1;
+    o->holes++;
+    markDirty(*o, (size_t)i, (size_t)i + 1);
+
+    if (o->holes * 2 > o->inst.size() && o->inst.size() >= kMinInstCap) compactObj(*o);
 }
 
 void UiRenderer::objRectOpts(Handle h, UiO opts, optarg_t arg) {
@@ -462,28 +1130,157 @@ void UiRenderer::objRectOpts(Handle h, UiO opts, optarg_t arg) {
 void UiRenderer::rectFilled(float x, float y, float w, float h, const UiColors& cc, float radius, float feather) {
     objRectFilled(m_frame, x, y, w, h, cc, radius, feather);
 }
-void UiRenderer::rectOutline(float x, float y, float w, float h, float t, const UiColors& cc) {
-    objRectOutline(m_frame, x, y, w, h, t, cc);
+void UiRenderer::rectOutline(float x, float y, float w, float h, float t, const UiColors& cc, float radius) {
+    objRectOutline(m_frame, x, y, w, h, t, cc, radius);
 }
 void UiRenderer::line(float x0, float y0, float x1, float y1, float thickness, const UiColors& cc) {
     objLine(m_frame, x0, y0, x1, y1, thickness, cc);
 }
+void UiRenderer::capsule(float x0, float y0, float x1, float y1, float thickness, const UiColors& cc) {
+    objCapsule(m_frame, x0, y0, x1, y1, thickness, cc);
+}
+void UiRenderer::circle(float cx, float cy, float r, const UiColors& cc, float feather) {
+    objCircle(m_frame, cx, cy, r, cc, feather);
+}
+void UiRenderer::ring(float cx, float cy, float r, float thickness, const UiColors& cc, float feather) {
+    objRing(m_frame, cx, cy, r, thickness, cc, feather);
+}
+void UiRenderer::pushClip(float x, float y, float w, float h) {
+    m_clipStack.push(ClipRect::fromXYWH(x, y, w, h));
+}
+void UiRenderer::popClip() {
+    m_clipStack.pop();
+}
+uint8_t UiRenderer::stateIndex(const ClipRect& clip, XformTable::Id xf) {
+    const UiState st{clip, xf};
+    for (size_t i = 0; i < m_states.size(); i++) {
+        if (m_states[i] == st) return (uint8_t)i;
+    }
+    if (m_states.size() >= (size_t)kMaxStates) compactStates();
+    if (m_states.size() >= (size_t)kMaxStates) {
+        if (!m_stateFullLogged) logx::Ef("state table full ({} clip/transform combinations), drawing unclipped", kMaxStates - 1);
+        m_stateFullLogged = true;
+        return 0;
+    }
+    m_states.push_back(st);
+    m_stateDirty = true;
+    return (uint8_t)(m_states.size() - 1);
+}
+// Drops table entries no recorded instance references any more and renumbers
+// the rest. Only runs when the table fills up (e.g. after many distinct
+// immediate-mode clips), so the full re-upload it causes is rare.
+void UiRenderer::compactStates() {
+    bool used[kMaxStates] = {};
+    used[0] = true;
+    for (const auto& in : m_frame.inst) used[in.state] = true;
+    for (const auto& o : m_objs) {
+        if (!o.alive) continue;
+        for (const auto& in : o.inst) used[in.state] = true;
+    }
+
+    uint8_t remap[kMaxStates] = {};
+    std::vector<UiState> table;
+    table.reserve(kMaxStates);
+    for (size_t i = 0; i < m_states.size(); i++) {
+        if (!used[i]) continue;
+        remap[i] = (uint8_t)table.size();
+        table.push_back(m_states[i]);
+    }
+    if (table.size() == m_states.size()) return;
+
+    auto apply = [&](UiObj& o) {
+        for (auto& in : o.inst) in.state = remap[in.state];
+        markDirty(o, 0, o.inst.size());
+    };
+    apply(m_frame);
+    for (auto& o : m_objs) {
+        if (o.alive) apply(o);
+    }
+    m_mergedLayoutDirty = true;
+    m_states = std::move(table);
+    m_stateDirty = true;
+}
+void UiRenderer::uploadStates() {
+    if (!m_stateUbo) return;
+    ProfScope ps(m_prof, ProfPhase::UiUpload);
+    // clip/transform lookups feed buildRuns()
+    if (m_stateDirty || m_xforms.dirty()) m_stateGen++;
+    if (m_stateDirty) {
+        m_stateDirty = false;
+        // clip rects, then one xf byte per state in a uint32 (= std140 uvec4[64])
+        ClipRect clips[kMaxStates];
+        uint32_t xfs[kMaxStates] = {};
+        for (size_t i = 0; i < m_states.size(); i++) {
+            clips[i] = m_states[i].clip;
+            xfs[i] = m_states[i].xf;
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, m_stateUbo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(clips), clips);
+        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(clips), sizeof(xfs), xfs);
+        if (m_prof) m_prof->count(ProfCounter::BytesUploaded, sizeof(clips) + sizeof(xfs));
+    }
+    if (m_xforms.dirty()) {
+        const size_t lo = m_xforms.dirtyLo(), hi = m_xforms.dirtyHi();
+        glBindBuffer(GL_UNIFORM_BUFFER, m_xformUbo);
+        glBufferSubData(GL_UNIFORM_BUFFER, (GLintptr)(lo * sizeof(Xform2D)),
+                        (GLsizeiptr)((hi - lo) * sizeof(Xform2D)), m_xforms.data() + lo);
+        if (m_prof) m_prof->count(ProfCounter::BytesUploaded, (hi - lo) * sizeof(Xform2D));
+        m_xforms.clearDirty();
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_stateUbo);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 1, m_xformUbo);
+}
+void UiRenderer::objSetLayer(Handle h, uint8_t layer) {
+    UiObj* o = get(h);
+    if (!o || o->layer == layer) return;
+    o->layer = layer;
+    o->changed = true;
+    m_mergedLayoutDirty = true;
+}
+void UiRenderer::objSetXform(Handle h, XformTable::Id xf) {
+    UiObj* o = get(h);
+    if (!o || o->xf == xf) return;
+    o->xf = xf;
+    // re-point every instance at (its clip, new transform); the slot's values
+    // themselves never touch instance data
+    for (auto& in : o->inst) in.state = stateIndex(m_states[in.state].clip, xf);
+    markDirty(*o, 0, o->inst.size());
+}
 void UiRenderer::begin() {
     objClear(m_frame);
+    m_frameLayers.clear();
+    m_frameLayerCur = 0;
 }
 void UiRenderer::end() {
-    uploadObj(m_frame, GL_DYNAMIC_DRAW);
+    uploadFrame();
 }
 void UiRenderer::draw(const float* mvp4x4) {
-   if (!m_prog || m_uMVP < 0) return;
+    if (!m_progs[0].prog) return;
+    m_list.begin(mvp4x4);
+    submitFrame(m_list);
+    m_list.flush();
+}
+void UiRenderer::submitFrame(DrawList& list) {
+    if (!m_progs[0].prog) return;
 
     // If you allow calling draw() without end()
-    uploadObj(m_frame, GL_DYNAMIC_DRAW);
-
-    glUseProgram(m_prog);
-    glUniformMatrix4fv(m_uMVP, 1, GL_FALSE, mvp4x4);
-
-    drawObj(m_frame);
+    uploadFrame();
+    // a slot the frame's instances use was set: same instances, new pixels
+    if (m_damage && m_xforms.dirty()) {
+        const size_t lo = m_xforms.dirtyLo(), hi = m_xforms.dirtyHi();
+        const size_t n = std::min(m_frameBounds.size(), m_frame.inst.size());
+        for (size_t i = 0; i < n; i++) {
+            const size_t xf = m_states[m_frame.inst[i].state].xf;
+            if (xf < lo || xf >= hi) continue;
+            m_damage->add(m_frameBounds[i]);
+            m_frameBounds[i] = frameInstBounds(m_frame.inst[i]);
+            m_damage->add(m_frameBounds[i]);
+        }
+    }
+    uploadStates();
 
-    glBindVertexArray(0);
+    for (const auto& lr : m_frameLayers) {
+        list.submit(lr.layer, kDepthFrame, m_progs[0].prog, 0, BlendMode::Premultiplied, &drawCmd, this, 0, lr.lo, lr.hi);
+    }
 }
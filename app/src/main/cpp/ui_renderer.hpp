@@ -6,8 +6,16 @@
 #include "assets.hpp"
 #include "types.hpp"
 #include "bitmask.hpp"
+#include "clip.hpp"
+#include "xform.hpp"
+#include "damage.hpp"
+#include "draw_list.hpp"
+#include "shader_library.hpp"
+#include "profiler.hpp"
 
 #include <cstdint>
+#include <cstddef>
+#include <memory>
 #include <vector>
 #include <variant>
 
@@ -27,15 +35,49 @@ struct bitmask::bitmask_traits<UiO> {
     static constexpr UiO mask = UiO::All;
 };
 
+// Per-instance primitive, evaluated analytically in ui.frag. Values match UI_SHAPE_* there.
+enum class UiShape : uint8_t {
+    Rect       = 0, // rounded rect, (hx, hy) half size
+    Segment    = 1, // oriented rounded box: (hx, hy) half axis vector, stroke = thickness
+    Circle     = 2, // disc of radius hx
+    Ring       = 3, // annulus, outer radius hx, stroke = ring width
+    RectStroke = 4, // rounded-rect outline inside the rect, stroke = line width
+};
+
 struct alignas(16) UiRectInst {
-    float cx, cy, hx, hy;      // vec4 c_half
-    float radius, feather;     // rad_fea.x/y
-    float _pad0, _pad1;        // pad to 16 bytes
-    uint32_t tl, tr, br, bl;   // uvec4 packed RGBA8
+    float cx, cy, hx, hy;      // center, half size (Segment: half axis)
+    float radius, stroke;      // corner radius, outline/ring/segment width
+    float feather;
+    UiShape shape;
+    uint8_t state;             // UiRenderer state table index (clip + transform), 0 = none
+    uint16_t _pad;
+    uint32_t tl, tr, br, bl;   // packed RGBA8
 };
 static_assert(sizeof(UiRectInst) == 48);
 static_assert(alignof(UiRectInst) == 16);
 
+// What actually goes to the GPU for a UiRectInst (32 bytes). The center is
+// 20.4 fixed point (fp16 steps are already 1-2 px on phone-sized screens) with
+// shape + feather (1/8 px) and the state index in the top bytes; half size /
+// radius / stroke are fp16. Packed on the CPU at upload (half::fromFloat4).
+struct UiInstGpu {
+    uint32_t cxShape;                     // cx (signed 24-bit, 1/16 px) | (shape | feather << 3) << 24
+    uint32_t cyState;                     // cy (signed 24-bit, 1/16 px) | state << 24
+    uint16_t hx, hy, radius, stroke;      // fp16, unpackHalf2x16 pairs
+    uint32_t tl, tr, br, bl;              // packed RGBA8
+};
+static_assert(sizeof(UiInstGpu) == 32);
+
+// UiInstGpu with linear-light fp16 corner colors (ColorFormat::LinearF16): 48 bytes.
+struct UiInstGpuF16 {
+    uint32_t cxShape;
+    uint32_t cyState;
+    uint16_t hx, hy, radius, stroke;
+    uint16_t tl[4], tr[4], br[4], bl[4];  // RGBA, fp16 pairs
+};
+static_assert(sizeof(UiInstGpuF16) == 48);
+static_assert(offsetof(UiInstGpuF16, tl) == offsetof(UiInstGpu, tl));
+
 struct UiColors {
     RGBA tl, tr, br, bl;
     UiColors() = default;
@@ -76,30 +118,131 @@ public:
     UiRenderer(const UiRenderer&) = delete;
     UiRenderer& operator=(const UiRenderer&) = delete;
 
+    // Where the packed instances (UiInstGpu, or UiInstGpuF16 for
+    // ColorFormat::LinearF16) live on the GPU; every backend reads the same words.
+    enum class Backend {
+        Auto,    // pick by capability at init()
+        Texture, // RGBA32UI instance texture, 2 texels per instance (3 with F16), texelFetch in ui.vert (ES 3.0 fallback)
+        Attrib,  // instanced integer vertex attributes (glVertexAttribDivisor) over the packed instance VBO
+        Ssbo,    // packed instance words in a vertex-stage SSBO (ES 3.1)
+    };
+    static const char* backendName(Backend b);
+
     /*Must be called after EGL context is current.
-    If you prefer to manage shaders outside, you can skip initProgram()
-    and provide your own program + uniform locations to draw().*/
-    bool init(const Assets::Manager& am);
+    If you prefer to manage shaders outside, you can skip init()
+    and provide your own program + uniform locations to draw().
+    A forced backend the context can't do falls back like Auto would.*/
+    bool init(const Assets::Manager& am, Backend backend = Backend::Auto);
+    // Same with ui.vert/ui.frag already read (e.g. by AsyncLoader).
+    bool init(const Assets::AssetView& vert, const Assets::AssetView& frag, Backend backend = Backend::Auto);
+    // init() in two steps, so the driver links while frames go on:
+    //   request()       - picks the backend and puts every program variant in
+    //                     flight on the ShaderLibrary; no link status is read.
+    //   programsReady() - true once finishInit() won't wait on the driver
+    //                     (always, without KHR_parallel_shader_compile).
+    //   finishInit()    - resolves the programs and creates the GL objects;
+    //                     a backend that fails to link falls back (blocking).
+    bool request(const Assets::AssetView& vert, const Assets::AssetView& frag, Backend backend = Backend::Auto);
+    bool programsReady() const;
+    bool finishInit();
     void shutdown();
+    Backend backend() const { return m_backend; }
+
+    // How corner colors are stored and blended; call before init().
+    //   Srgb8     - RGBA8 as given (sRGB), 32-byte instances
+    //   LinearF16 - converted to linear light at pack time (256-entry LUT) and
+    //               stored as fp16, 48-byte instances; gradients interpolate in linear
+    // srgbTarget: the framebuffer encodes on write (EGL_GL_COLORSPACE_SRGB), so
+    // ui.frag outputs linear premultiplied color with no pow() at all. Auto picks
+    // LinearF16 for an sRGB target (linear RGBA8 would band in dark colors), else Srgb8.
+    enum class ColorFormat { Auto, Srgb8, LinearF16 };
+    void setColorOutput(bool srgbTarget, ColorFormat format = ColorFormat::Auto);
+    ColorFormat colorFormat() const { return m_colorFormat; }
+
+    // Programs come from a ShaderLibrary shared with the other renderers of
+    // this context (not owned); without one, init() makes a private library.
+    // Call before init().
+    void setShaderLibrary(ShaderLibrary* lib) { m_shaders = lib; }
+
+    // Screen regions this renderer changed are added to *damage (not owned)
+    // during submit()/destroyObj(): old and new bounds of every edited, moved
+    // or faded object, and of the immediate-mode frame whenever its recorded
+    // instances differ from the last frame's. Bounds are conservative (AA
+    // fringe included, per-instance clips ignored for objects).
+    void setDamage(Damage* damage) { m_damage = damage; }
+    // Retained state (objects, transform slots) changed since the last submit.
+    // Immediate-mode recording is not included: the caller knows when it records.
+    bool needsRedraw() const;
+
+    // Uploads are timed as UiUpload and counted (bytes, draw calls) into
+    // *prof (not owned; null = off).
+    void setProfiler(Profiler* prof) { m_prof = prof; }
 
     // Record UI geometry for this frame
     void begin(); // clears internal vertex list
     void rectFilled(float x, float y, float w, float h, const UiColors& cc, float radius = 0.0f, float feather = 1.0f);
-    void rectOutline(float x, float y, float w, float h, float t, const UiColors& cc);
+    void rectOutline(float x, float y, float w, float h, float t, const UiColors& cc, float radius = 0.0f);
     void line(float x0, float y0, float x1, float y1, float thickness, const UiColors& cc);
+    void capsule(float x0, float y0, float x1, float y1, float thickness, const UiColors& cc);
+    void circle(float cx, float cy, float r, const UiColors& cc, float feather = 1.0f);
+    void ring(float cx, float cy, float r, float thickness, const UiColors& cc, float feather = 1.0f);
     void end();   // uploads VBO (or you can upload in draw)
 
+    // Clip stack (screen space). Everything recorded while a clip is pushed -
+    // immediate-mode or into an object - carries an index into a small state
+    // table (clip rect + transform slot) the shaders read, so clipped and
+    // unclipped content still share one draw. Immediate-mode items entirely
+    // outside the clip are dropped when recorded; retained ones may be moved
+    // into view by a transform later, so they are only masked in ui.frag.
+    void pushClip(float x, float y, float w, float h);
+    void popClip();
+    static constexpr int kMaxStates = 256;
+
+    // Per-object transform + opacity. Slots live in xforms() (uploaded as a
+    // UBO); changing a slot's value touches 32 bytes and no instance data.
+    // A slot can also be shared with TextRenderer::setXform for grouped animation.
+    XformTable& xforms() { return m_xforms; }
+    const XformTable& xforms() const { return m_xforms; }
+
     // Draw all recorded UI. Requires an orthographic MVP like your text uses.
     // If you use UiRenderer’s internal program, pass program=0 and uMVP=-1 to use internal.
     void draw(const float* mvp4x4);
 
+    // Frame draw list (see DrawList). Higher layers draw on top of lower ones,
+    // across renderers; within a layer immediate-mode items (kDepthFrame) go
+    // under objects (kDepthObjects), and TextRenderer uses a higher depth still.
+    // Immediate-mode items take the layer set when recorded (reset by begin()).
+    static constexpr uint16_t kDepthFrame = 0;
+    static constexpr uint16_t kDepthObjects = 1;
+    void setLayer(uint8_t layer) { m_frameLayerCur = layer; }
+    // Uploads now, draws at list.flush(). submit() = submitFrame() + submitObjects().
+    void submit(DrawList& list);
+    void submitFrame(DrawList& list);
+    void submitObjects(DrawList& list);
+
     struct Handle { int id = -1; };
     Handle createObj();
     void destroyObj(Handle h);
     void objClear(Handle h);
-    void objRectFilled(Handle hdl, float x, float y, float w, float h, const UiColors& cc, float radius = 0.0f, float feather = 1.0f);
-    void objRectOutline(Handle hdl, float x, float y, float w, float h, float t, const UiColors& cc);
-    void objLine(Handle hdl, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc);
+
+    // Stable id of one element (rect, line, ...) inside an object. Valid until
+    // it is removed or the object is cleared/destroyed; removing an element
+    // never changes other ids or the draw order of the rest.
+    struct Elem { int id = -1; };
+    Elem objRectFilled(Handle hdl, float x, float y, float w, float h, const UiColors& cc, float radius = 0.0f, float feather = 1.0f);
+    Elem objRectOutline(Handle hdl, float x, float y, float w, float h, float t, const UiColors& cc, float radius = 0.0f);
+    Elem objLine(Handle hdl, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc);
+    Elem objCapsule(Handle hdl, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc);
+    Elem objCircle(Handle hdl, float cx, float cy, float r, const UiColors& cc, float feather = 1.0f);
+    Elem objRing(Handle hdl, float cx, float cy, float r, float thickness, const UiColors& cc, float feather = 1.0f);
+
+    // Single-element edits; the next upload re-sends just the touched instances.
+    // objSetRect keeps shape, colors and style: rects take the box, circles and
+    // rings are centered in it (radius min(w, h) / 2), lines and capsules run
+    // from (x, y) to (x + w, y + h).
+    void objSetRect(Handle hdl, Elem e, float x, float y, float w, float h);
+    void objSetColors(Handle hdl, Elem e, const UiColors& cc);
+    void objRemove(Handle hdl, Elem e);
 
     using optarg_t = std::variant<
         std::monostate,
@@ -107,17 +250,45 @@ public:
         UiColors
     >;
     void objRectOpts(Handle h, UiO opts, optarg_t arg = {});
+    void objSetXform(Handle h, XformTable::Id xf);
+    void objSetLayer(Handle h, uint8_t layer);
     template<class T> requires std::constructible_from<optarg_t, T>
     void objRectOpts(Handle h, UiO opts, T&& arg) { objRectOpts(h, opts, optarg_t{std::forward<T>(arg)}); }
     
+    // Merged mode (default): all live objects' instances are packed into one
+    // shared store in creation-slot order and drawn with a single instanced call.
+    // Off: one upload/draw per object.
+    void setMerged(bool on);
+    bool merged() const { return m_mergedMode; }
+
     void updateObjects();
     void drawObjects(const float* mvp4x4);
 
     // Optional: use internal program (created in init()).
-    GLuint program() const { return m_prog; }
-    GLint  uMVP() const { return m_uMVP; }
+    GLuint program() const { return m_progs[0].prog; }
+    GLint  uMVP() const { return m_progs[0].uMVP; }
+
+    // Fragment variants of ui.frag (UI_VARIANT_* defines). Unrotated, unscaled,
+    // square-cornered rects with pixel-aligned edges need no SDF or AA: they go
+    // through Solid (one color) or Gradient (corner colors). Each store is drawn
+    // as runs of consecutive same-variant instances, so z-order is unchanged.
+    enum class Variant : uint8_t { General, Solid, Gradient, Count };
 
     int vertexCount() const { return (int)m_frame.inst.size(); }
+
+    // Immediate-mode upload accounting: each end()/draw() diffs the recorded
+    // frame against the previous one and uploads nothing, changed runs, or all.
+    enum class FrameUpload { Skipped, Partial, Full };
+    struct FrameUploadStats {
+        FrameUpload last = FrameUpload::Skipped;
+        size_t   lastSent = 0;   // instances uploaded by the last frame
+        uint64_t skipped = 0;
+        uint64_t partial = 0;
+        uint64_t full = 0;
+        uint64_t instSent = 0;
+    };
+    const FrameUploadStats& frameUploadStats() const { return m_frameStats; }
+    void resetFrameUploadStats() { m_frameStats = {}; }
 private:
     struct UiObj {
         bool alive = true;
@@ -126,40 +297,166 @@ private:
         std::vector<UiRectInst> inst;
         GLsizei instanceCount = 0;
     
-        GLuint texF = 0; // RGBA16F/32F
-        GLuint texU = 0; // RGBA8UI
-    
-        int wF = 0, hF = 0;
-        int wU = 0, hU = 0;
+        // Backend::Texture: RGBA32UI, m_instTexels texels per packed instance
+        GLuint tex = 0;
+        int texW = 0, texH = 0;
+
+        // Backend::Attrib (VBO + per-object VAO) / Backend::Ssbo (SSBO)
+        GLuint buf = 0;
+        GLuint vao = 0;
+
+        // GPU storage is sized for capInst instances (with headroom) and kept
+        // across edits; only instances whose dirtyBits are set are re-sent.
+        // [dirtyLo, dirtyHi) bounds the set bits.
+        size_t capInst = 0;
+        size_t dirtyLo = SIZE_MAX;
+        size_t dirtyHi = 0;
+        std::vector<uint64_t> dirtyBits;
+
+        // Element id -> index in inst (-1 = removed) and back. Removed elements
+        // stay as empty instances until holes outnumber live ones. Not kept for m_frame.
+        std::vector<int32_t> elemIndex;
+        std::vector<int32_t> instElem;
+        size_t holes = 0;
+
+        XformTable::Id xf = 0;
+        uint8_t layer = 0;
+
+        // Range inside m_merged (merged mode)
+        size_t mergedBase = 0;
+        size_t mergedCount = 0;
+
+        // Draw runs over [0, instanceCount), rebuilt after edits or state/xform changes
+        struct Run { Variant variant; uint32_t first, count; };
+        std::vector<Run> runs;
+        bool runsDirty = true;
+        uint64_t runsGen = 0;
+
+        // Damage tracking: set by any edit, cleared when submitted. local is
+        // the instances' union before the transform, drawn the screen bounds
+        // (and the slot value) they were last submitted with.
+        bool changed = true;
+        ClipRect local{};
+        ClipRect drawn{};
+        Xform2D drawnXf{};
+        size_t attribBase = 0; // Backend::Attrib: instance the VAO's pointers start at
+    };
+    struct UiProg {
+        ShaderLibrary::Id id = -1;
+        GLuint prog = 0;
+        GLint uMVP = -1;
+        GLint uInst = -1, uInst_W = -1;
+        GLint uInstBase = -1;
     };
+    // consecutive instances of one store sharing a layer
+    struct LayerRange { uint8_t layer; uint32_t lo, hi; };
 
     UiObj* get(Handle h);
     void destroyObj(UiObj& o);
     void objClear(UiObj& o);
-    void objRectFilled(UiObj& o, float x, float y, float w, float h, const UiColors& cc, float radius = 0.0f, float feather = 1.0f);
-    void objRectOutline(UiObj& o, float x, float y, float w, float h, float t, const UiColors& cc);
-    void objLine(UiObj& o, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc);
+    Elem objRectFilled(UiObj& o, float x, float y, float w, float h, const UiColors& cc, float radius = 0.0f, float feather = 1.0f);
+    Elem objRectOutline(UiObj& o, float x, float y, float w, float h, float t, const UiColors& cc, float radius = 0.0f);
+    Elem objLine(UiObj& o, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc);
+    Elem objCapsule(UiObj& o, float x0, float y0, float x1, float y1, float thickness, const UiColors& cc);
+    Elem objCircle(UiObj& o, float cx, float cy, float r, const UiColors& cc, float feather = 1.0f);
+    Elem objRing(UiObj& o, float cx, float cy, float r, float thickness, const UiColors& cc, float feather = 1.0f);
+    Elem objPush(UiObj& o, const UiRectInst& inst);
+    static int elemIndex(const UiObj& o, Elem e);
+    void compactObj(UiObj& o);
+
+    uint8_t stateIndex(const ClipRect& clip, XformTable::Id xf);
+    void compactStates();
+    void uploadStates();
 
     void objSetUiColors(UiObj& o, UiO opts, const UiColors& cc);
     void objRectOpts(UiObj& o, UiO opts, optarg_t arg);
     
-    bool initProgram(const Assets::Manager& am);
+    void requestPrograms(Backend backend);
+    bool resolvePrograms();
     void destroyProgram();
+    Backend pickBackend(Backend wanted) const;
+    void setupAttribVao(UiObj& o);
+    void pointInstAttribs(size_t first) const;
+    static void markDirty(UiObj& o, size_t lo, size_t hi);
+    static void clearDirty(UiObj& o);
+    struct DirtyRun { size_t lo, hi; };
+    // set bits as runs (gaps under kDirtyGap merged), then clears them
+    static void takeDirtyRuns(UiObj& o, std::vector<DirtyRun>& out);
+    static constexpr size_t kDirtyGap = 8;
+    bool reserveObj(UiObj& o, size_t count, GLenum usage);
     void uploadObj(UiObj& o, GLenum usage);
-    void drawObj(const UiObj& o);
+    void uploadRange(UiObj& o, size_t lo, size_t hi);
+    void uploadFrame();
+    void mergeObjects();
+    static ClipRect instBounds(const UiRectInst& in);
+    void damageObj(UiObj& o);
+    ClipRect frameInstBounds(const UiRectInst& in) const;
+    void damageFrame(size_t lo, size_t hi);
+    void truncateFrameBounds(size_t count);
+    Variant classify(const UiRectInst& in) const;
+    void buildRuns(UiObj& o);
+    const UiProg& useVariant(Variant v, DrawList& list);
+    void drawObj(UiObj& o, size_t lo, size_t hi, DrawList& list);
+    static void drawCmd(void* ctx, uint32_t store, uint32_t lo, uint32_t hi, DrawList& list);
 
 private:
+    Backend m_backend = Backend::Texture;
+    GLint m_maxTex = 0;
+    static constexpr size_t kMinInstCap = 64;
+    std::vector<DirtyRun> m_dirtyRuns; // scratch for takeDirtyRuns
+    // Upload staging (packed UiInstGpu / UiInstGpuF16), reused across objects and frames
+    std::vector<UiInstGpu> m_stage;
+    std::vector<UiInstGpuF16> m_stageF16;
+
+    bool m_srgbTarget = false;
+    ColorFormat m_colorWanted = ColorFormat::Auto;
+    ColorFormat m_colorFormat = ColorFormat::Srgb8;
+    ShaderLibrary* m_shaders = nullptr;
+    std::unique_ptr<ShaderLibrary> m_ownShaders;
+    Assets::AssetView m_vs, m_fs; // ui.vert/ui.frag between request() and finishInit()
+    Damage* m_damage = nullptr;
+    Profiler* m_prof = nullptr;
+    // screen bounds each m_frame instance was last uploaded with (parallel to
+    // m_framePrev), so only instances that differ from last frame are damaged
+    std::vector<ClipRect> m_frameBounds;
+    size_t m_instBytes = sizeof(UiInstGpu);  // per-instance GPU stride
+    int m_instTexels = 2;                    // Backend::Texture: RGBA32UI texels per instance
+
     UiObj m_frame;
+    std::vector<UiRectInst> m_framePrev; // what m_frame's GPU storage holds
+    FrameUploadStats m_frameStats;
+    static constexpr size_t kFrameChunk = 16; // diff granularity, instances
     std::vector<UiObj> m_objs;
+    UiObj m_merged;
+    std::vector<LayerRange> m_frameLayers;  // over m_frame.inst, in record order
+    std::vector<LayerRange> m_mergedLayers; // over m_merged.inst, ascending layer
+    uint8_t m_frameLayerCur = 0;
+    DrawList m_list; // draw() / drawObjects() without an external list
+
+    // State table (entry 0 = unclipped, identity), mirrored into m_stateUbo
+    struct UiState {
+        ClipRect clip;
+        XformTable::Id xf;
+        bool operator==(const UiState&) const = default;
+    };
+    ClipStack m_clipStack;
+    std::vector<UiState> m_states{ UiState{ClipRect::none(), 0} };
+    bool m_stateDirty = true;
+    bool m_stateFullLogged = false;
+    GLuint m_stateUbo = 0;
+
+    XformTable m_xforms;
+    GLuint m_xformUbo = 0;
+    uint64_t m_stateGen = 1; // bumped whenever state/xform tables are re-sent
+    bool m_mergedMode = true;
+    bool m_mergedLayoutDirty = true;
 
-    // Internal shader (optional)
-    GLuint m_prog = 0;
-    GLint  m_uMVP = -1;
+    // Internal shaders (optional), indexed by Variant
+    UiProg m_progs[(int)Variant::Count];
+    // fast runs smaller than this (px^2) are folded into General: the saved
+    // fragment work is less than an extra draw + program switch
+    static constexpr float kVariantMinArea = 128.0f * 128.0f;
     GLuint m_quadVao = 0;
     GLuint m_quadVbo = 0;
     GLuint m_quadEbo = 0;
-    GLint m_uInstF  = -1;
-    GLint m_uInstU  = -1;
-    GLint m_uInstF_W = -1;
-    GLint m_uInstU_W = -1;
 };
\ No newline at end of file
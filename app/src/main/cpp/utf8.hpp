@@ -0,0 +1,42 @@
+// utf8.hpp - minimal UTF-8 helpers shared by the text pipeline
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+namespace utf8 {
+
+// codepoint index -> utf8 byte offset (size = N+1, last entry is strlen)
+inline std::vector<uint32_t> buildIndex(const char* s) {
+    std::vector<uint32_t> out;
+    for (uint32_t i = 0; s[i]; ) {
+        out.push_back(i);
+        unsigned char c = (unsigned char)s[i];
+        i += (c < 0x80) ? 1 :
+             ((c & 0xE0) == 0xC0) ? 2 :
+             ((c & 0xF0) == 0xE0) ? 3 : 4;
+    }
+    out.push_back((uint32_t)std::strlen(s));
+    return out;
+}
+inline int codepointCount(const std::vector<uint32_t>& cpByteOffsets) {
+    return (cpByteOffsets.size() >= 1) ? (int)cpByteOffsets.size() - 1 : 0;
+}
+inline int codepointIndexFromCluster(uint32_t clusterByte, const std::vector<uint32_t>& cpByteOffsets) {
+    // find greatest i where cpByteOffsets[i] <= clusterByte
+    auto it = std::upper_bound(cpByteOffsets.begin(), cpByteOffsets.end(), clusterByte);
+    if (it == cpByteOffsets.begin()) return 0;
+    return (int)std::distance(cpByteOffsets.begin(), it - 1);
+}
+inline uint32_t decodeOne(const char* s, int& advBytes) {
+    const unsigned char c0 = (unsigned char)s[0];
+    if (c0 < 0x80) { advBytes = 1; return c0; }
+    if ((c0 & 0xE0) == 0xC0) { advBytes = 2; return ((c0 & 0x1F) << 6) | (s[1] & 0x3F); }
+    if ((c0 & 0xF0) == 0xE0) { advBytes = 3; return ((c0 & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F); }
+    advBytes = 4;
+    return ((c0 & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+}
+
+} // namespace utf8
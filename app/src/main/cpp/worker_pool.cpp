@@ -0,0 +1,73 @@
+// worker_pool.cpp
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned threads) {
+    m_threads.reserve(threads);
+    for (unsigned i = 0; i < threads; i++) {
+        m_threads.emplace_back([this, i] { workerMain(i + 1); });
+    }
+}
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lk(m_mx);
+        m_stop = true;
+    }
+    m_wakeCv.notify_all();
+    for (auto& t : m_threads) t.join();
+}
+
+WorkerPool& WorkerPool::shared() {
+    // leave a core for the UI/looper side; more than 8 rarely pays off for UI text
+    static WorkerPool pool(std::clamp(std::thread::hardware_concurrency(), 1u, 8u) - 1u);
+    return pool;
+}
+
+void WorkerPool::parallelFor(size_t n, const ForFn& fn) {
+    if (n == 0) return;
+    if (m_threads.empty() || n == 1) {
+        for (size_t i = 0; i < n; i++) fn(i, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> forLk(m_forMx);
+    {
+        std::lock_guard<std::mutex> lk(m_mx);
+        m_fn = &fn;
+        m_n = n;
+        m_next.store(0, std::memory_order_relaxed);
+        m_busy = (unsigned)m_threads.size();
+        ++m_gen;
+    }
+    m_wakeCv.notify_all();
+
+    drain(0);
+
+    std::unique_lock<std::mutex> lk(m_mx);
+    m_doneCv.wait(lk, [&] { return m_busy == 0; });
+    m_fn = nullptr;
+}
+
+void WorkerPool::drain(unsigned worker) {
+    for (size_t i; (i = m_next.fetch_add(1, std::memory_order_relaxed)) < m_n; ) {
+        (*m_fn)(i, worker);
+    }
+}
+
+void WorkerPool::workerMain(unsigned worker) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(m_mx);
+            m_wakeCv.wait(lk, [&] { return m_stop || m_gen != seen; });
+            if (m_stop) return;
+            seen = m_gen;
+        }
+        drain(worker);
+        {
+            std::lock_guard<std::mutex> lk(m_mx);
+            if (--m_busy == 0) m_doneCv.notify_one();
+        }
+    }
+}
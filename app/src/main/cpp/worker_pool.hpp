@@ -0,0 +1,50 @@
+// worker_pool.hpp - tiny fork/join pool for CPU-side batch work (shaping, meshing, ...)
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+    // threads = extra worker threads; the calling thread always participates.
+    explicit WorkerPool(unsigned threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Process-wide pool sized from hardware_concurrency().
+    static WorkerPool& shared();
+
+    // Number of distinct worker indices parallelFor can pass (threads + caller).
+    unsigned workerCount() const { return (unsigned)m_threads.size() + 1; }
+
+    using ForFn = std::function<void(size_t index, unsigned worker)>;
+    // Runs fn(i, worker) for every i in [0, n) and blocks until all are done.
+    // worker is in [0, workerCount()); 0 is the calling thread. Each worker index
+    // is used by one thread at a time, so it can address per-thread scratch state.
+    void parallelFor(size_t n, const ForFn& fn);
+
+private:
+    void workerMain(unsigned worker);
+    void drain(unsigned worker);
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_forMx;                 // one parallelFor at a time
+    std::mutex m_mx;
+    std::condition_variable m_wakeCv;
+    std::condition_variable m_doneCv;
+    const ForFn* m_fn = nullptr;
+    size_t m_n = 0;
+    std::atomic<size_t> m_next{0};
+    unsigned m_busy = 0;
+    uint64_t m_gen = 0;
+    bool m_stop = false;
+};
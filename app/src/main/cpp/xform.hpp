@@ -0,0 +1,92 @@
+// xform.hpp - 2D affine transform + opacity slots shared by UiRenderer and TextRenderer
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+// x' = a*x + c*y + tx, y' = b*x + d*y + ty (column-major, matches GLSL mat2(a,b,c,d)).
+// 32 bytes = two std140 vec4s: (a b c d) (tx ty opacity _).
+struct Xform2D {
+    float a = 1.0f, b = 0.0f, c = 0.0f, d = 1.0f;
+    float tx = 0.0f, ty = 0.0f;
+    float opacity = 1.0f;
+    float _pad = 0.0f;
+
+    // translate * rotate * scale about pivot (px, py)
+    static Xform2D trs(float tx, float ty, float sx = 1.0f, float sy = 1.0f, float rot = 0.0f,
+                       float px = 0.0f, float py = 0.0f, float opacity = 1.0f) {
+        const float cs = std::cos(rot), sn = std::sin(rot);
+        Xform2D m;
+        m.a = cs * sx;  m.b = sn * sx;
+        m.c = -sn * sy; m.d = cs * sy;
+        m.tx = px + tx - (m.a * px + m.c * py);
+        m.ty = py + ty - (m.b * px + m.d * py);
+        m.opacity = opacity;
+        return m;
+    }
+    void apply(float x, float y, float& ox, float& oy) const {
+        ox = a * x + c * y + tx;
+        oy = b * x + d * y + ty;
+    }
+    // axis-aligned bounds of the transformed box
+    void applyBounds(float& x0, float& y0, float& x1, float& y1) const {
+        float xs[4], ys[4];
+        apply(x0, y0, xs[0], ys[0]);
+        apply(x1, y0, xs[1], ys[1]);
+        apply(x1, y1, xs[2], ys[2]);
+        apply(x0, y1, xs[3], ys[3]);
+        x0 = *std::min_element(xs, xs + 4); x1 = *std::max_element(xs, xs + 4);
+        y0 = *std::min_element(ys, ys + 4); y1 = *std::max_element(ys, ys + 4);
+    }
+};
+static_assert(sizeof(Xform2D) == 32);
+
+// Fixed-size slot table; slot 0 is the identity and can't be changed.
+// Setting a slot only marks that slot for upload, so animating an object
+// costs one 32-byte glBufferSubData (see UiRenderer).
+class XformTable {
+public:
+    using Id = uint8_t;
+    static constexpr int kMax = 256;
+
+    XformTable() : m_xf(kMax) { m_used[0] = true; }
+
+    // Returns 0 (identity) when every slot is taken.
+    Id create(const Xform2D& xf = {}) {
+        for (int i = 1; i < kMax; i++) {
+            if (m_used[i]) continue;
+            m_used[i] = true;
+            set((Id)i, xf);
+            return (Id)i;
+        }
+        return 0;
+    }
+    void destroy(Id id) {
+        if (!id) return;
+        m_used[id] = false;
+        set(id, Xform2D{}); // stale references draw untransformed
+    }
+    void set(Id id, const Xform2D& xf) {
+        if (!id) return;
+        m_xf[id] = xf;
+        m_dirtyLo = std::min(m_dirtyLo, (size_t)id);
+        m_dirtyHi = std::max(m_dirtyHi, (size_t)id + 1);
+    }
+    const Xform2D& get(Id id) const { return m_xf[id]; }
+    const Xform2D* data() const { return m_xf.data(); }
+
+    // [lo, hi) slots changed since the last clearDirty()
+    bool dirty() const { return m_dirtyLo < m_dirtyHi; }
+    size_t dirtyLo() const { return m_dirtyLo; }
+    size_t dirtyHi() const { return m_dirtyHi; }
+    void markAllDirty() { m_dirtyLo = 0; m_dirtyHi = kMax; }
+    void clearDirty() { m_dirtyLo = SIZE_MAX; m_dirtyHi = 0; }
+
+private:
+    std::vector<Xform2D> m_xf;
+    bool m_used[kMax] = {};
+    size_t m_dirtyLo = 0, m_dirtyHi = kMax;
+};
@@ -0,0 +1,237 @@
+// program_cache_test.cpp - ProgramCache against an in-memory GL (FakeProgramGl)
+//
+// usage: program_cache_test
+//
+// Each case runs in a fresh directory under the system temp dir. Prints one
+// line per failed check; exits non-zero if any failed.
+#include "program_cache.hpp"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static int g_failed = 0;
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            g_failed++;                                                      \
+        }                                                                    \
+    } while (0)
+
+// Programs are their binaries; link() stands in for compiling from source.
+class FakeProgramGl : public ProgramGl {
+public:
+    static constexpr uint32_t kFormat = 0x8741;
+
+    std::string device = "FakeGPU|OpenGL ES 3.2 fake-1";
+    bool supported = true;
+    bool reject = false; // loadBinary() fails like a driver refusing the binary
+
+    uint32_t link(std::string_view vs, std::string_view fs) {
+        std::vector<uint8_t> bin(vs.begin(), vs.end());
+        bin.push_back(0);
+        bin.insert(bin.end(), fs.begin(), fs.end());
+        return add(std::move(bin));
+    }
+    const std::vector<uint8_t>* binary(uint32_t prog) const {
+        const auto it = m_progs.find(prog);
+        return it != m_progs.end() ? &it->second : nullptr;
+    }
+
+    std::string deviceId() const override { return device; }
+    bool binarySupported() const override { return supported; }
+    uint32_t loadBinary(uint32_t format, const void* data, size_t size) override {
+        if (reject || format != kFormat) return 0;
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        return add(std::vector<uint8_t>(p, p + size));
+    }
+    bool getBinary(uint32_t prog, uint32_t& format, std::vector<uint8_t>& out) override {
+        const std::vector<uint8_t>* bin = binary(prog);
+        if (!bin) return false;
+        format = kFormat;
+        out = *bin;
+        return true;
+    }
+
+private:
+    uint32_t add(std::vector<uint8_t> bin) {
+        m_progs[m_next] = std::move(bin);
+        return m_next++;
+    }
+    std::map<uint32_t, std::vector<uint8_t>> m_progs;
+    uint32_t m_next = 1;
+};
+
+static constexpr std::string_view kVs = "#version 300 es\nvoid main() { gl_Position = vec4(0.0); }\n";
+static constexpr std::string_view kFs = "#version 300 es\nprecision mediump float;\nout vec4 o;\nvoid main() { o = vec4(1.0); }\n";
+
+struct TempDir {
+    fs::path path;
+    explicit TempDir(const char* name) {
+        path = fs::temp_directory_path() / (std::string("program_cache_test_") + name + "_" + std::to_string(getpid()));
+        fs::remove_all(path);
+        fs::create_directories(path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+    // the one cache file store() wrote
+    fs::path cacheFile() const {
+        for (const auto& e : fs::directory_iterator(path)) {
+            if (e.path().extension() == ".bin") return e.path();
+        }
+        return {};
+    }
+};
+
+// Compiles on a miss and stores, like ShaderLibrary does.
+static uint32_t loadOrLink(ProgramCache& cache, FakeProgramGl& gl) {
+    if (const uint32_t prog = cache.load(kVs, kFs)) return prog;
+    const uint32_t prog = gl.link(kVs, kFs);
+    cache.store(kVs, kFs, prog);
+    return prog;
+}
+
+static void missThenStore() {
+    TempDir dir("miss");
+    FakeProgramGl gl;
+    ProgramCache cache(gl, dir.path.string());
+    CHECK(cache.load(kVs, kFs) == 0);
+    CHECK(cache.stats().misses == 1);
+    const uint32_t prog = gl.link(kVs, kFs);
+    CHECK(cache.store(kVs, kFs, prog));
+    CHECK(cache.stats().stored == 1);
+    CHECK(!dir.cacheFile().empty());
+}
+
+static void warmHit() {
+    TempDir dir("hit");
+    FakeProgramGl gl;
+    const uint32_t linked = [&] {
+        ProgramCache cold(gl, dir.path.string());
+        return loadOrLink(cold, gl);
+    }();
+    // a new cache = the next window init / app start
+    ProgramCache warm(gl, dir.path.string());
+    const uint32_t prog = warm.load(kVs, kFs);
+    CHECK(prog != 0);
+    CHECK(warm.stats().hits == 1 && warm.stats().misses == 0);
+    CHECK(gl.binary(prog) && gl.binary(linked) && *gl.binary(prog) == *gl.binary(linked));
+    // other sources don't hit this entry
+    CHECK(warm.load(kVs, "void main() {}") == 0);
+    CHECK(warm.stats().misses == 1);
+}
+
+static void rejectedThenRestored() {
+    TempDir dir("rejected");
+    FakeProgramGl gl;
+    {
+        ProgramCache cold(gl, dir.path.string());
+        loadOrLink(cold, gl);
+    }
+    gl.reject = true;
+    ProgramCache cache(gl, dir.path.string());
+    CHECK(cache.load(kVs, kFs) == 0);
+    CHECK(cache.stats().rejected == 1 && cache.stats().hits == 0 && cache.stats().misses == 0);
+    // the relinked program overwrites the refused binary
+    gl.reject = false;
+    CHECK(cache.store(kVs, kFs, gl.link(kVs, kFs)));
+    CHECK(cache.stats().stored == 1);
+    ProgramCache warm(gl, dir.path.string());
+    CHECK(warm.load(kVs, kFs) != 0);
+    CHECK(warm.stats().hits == 1);
+}
+
+static void deviceChangeInvalidates() {
+    TempDir dir("device");
+    FakeProgramGl gl;
+    {
+        ProgramCache cold(gl, dir.path.string());
+        loadOrLink(cold, gl);
+    }
+    // e.g. a driver update: same file name, header no longer matches
+    gl.device = "FakeGPU|OpenGL ES 3.2 fake-2";
+    ProgramCache cache(gl, dir.path.string());
+    CHECK(cache.load(kVs, kFs) == 0);
+    CHECK(cache.stats().misses == 1 && cache.stats().rejected == 0);
+    loadOrLink(cache, gl);
+    ProgramCache warm(gl, dir.path.string());
+    CHECK(warm.load(kVs, kFs) != 0);
+    // the old entry was rewritten, not left behind
+    size_t files = 0;
+    for (const auto& e : fs::directory_iterator(dir.path)) files += e.path().extension() == ".bin";
+    CHECK(files == 1);
+}
+
+static void truncatedOrForeignFileMisses() {
+    TempDir dir("corrupt");
+    FakeProgramGl gl;
+    {
+        ProgramCache cold(gl, dir.path.string());
+        loadOrLink(cold, gl);
+    }
+    const fs::path file = dir.cacheFile();
+    CHECK(!file.empty());
+    if (file.empty()) return;
+    const uintmax_t size = fs::file_size(file);
+
+    // header intact, payload cut short
+    fs::resize_file(file, size - 4);
+    {
+        ProgramCache cache(gl, dir.path.string());
+        CHECK(cache.load(kVs, kFs) == 0);
+        CHECK(cache.stats().misses == 1 && cache.stats().rejected == 0);
+    }
+    // shorter than the header
+    fs::resize_file(file, 7);
+    {
+        ProgramCache cache(gl, dir.path.string());
+        CHECK(cache.load(kVs, kFs) == 0);
+        CHECK(cache.stats().misses == 1);
+    }
+    // not a cache file at all
+    {
+        std::ofstream out(file, std::ios::binary | std::ios::trunc);
+        const std::string junk(size, 'x');
+        out.write(junk.data(), (std::streamsize)junk.size());
+    }
+    {
+        ProgramCache cache(gl, dir.path.string());
+        CHECK(cache.load(kVs, kFs) == 0);
+        CHECK(cache.stats().misses == 1 && cache.stats().rejected == 0);
+    }
+}
+
+static void noBinarySupport() {
+    TempDir dir("unsupported");
+    FakeProgramGl gl;
+    gl.supported = false;
+    ProgramCache cache(gl, dir.path.string());
+    CHECK(cache.load(kVs, kFs) == 0);
+    CHECK(!cache.store(kVs, kFs, gl.link(kVs, kFs)));
+    CHECK(dir.cacheFile().empty());
+}
+
+int main() {
+    missThenStore();
+    warmHit();
+    rejectedThenRestored();
+    deviceChangeInvalidates();
+    truncatedOrForeignFileMisses();
+    noBinarySupport();
+    if (g_failed) {
+        std::fprintf(stderr, "program_cache_test: %d check(s) failed\n", g_failed);
+        return 1;
+    }
+    std::printf("program_cache_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+// mkbundle.cpp - packs the app's assets into one Assets bundle (asset_bundle.hpp)
+//
+// usage: mkbundle OUT ROOT [--font PATH]... [--atlas NAME PX TEXT]... [--atlas-size N]
+//
+//   ROOT          every file under it, named by its path relative to ROOT
+//                 ("shaders/ui.vert"); usually app/src/main/assets
+//   --font PATH   a host font file, added as "fonts/<file name>" (what
+//                 copyfont.sh used to copy in)
+//   --atlas       bake TEXT from bundled "fonts/NAME" at PX pixels into
+//                 Assets::atlasName(NAME, PX), for TextRenderer::loadAtlas
+//   --atlas-size  atlas width/height the app passes to initFont (2048)
+//
+// Write OUT into the assets directory as assets.bundle; it must be stored
+// uncompressed in the APK (noCompress in build.gradle.kts).
+#include "asset_bundle.hpp"
+#include "text_shaper.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+static bool readFile(const fs::path& p, std::vector<uint8_t>& out) {
+    std::ifstream in(p, std::ios::binary);
+    if (!in.is_open()) return false;
+    out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+struct AtlasJob {
+    std::string font;
+    int px = 0;
+    std::string text;
+};
+
+static void usage() {
+    std::fprintf(stderr, "usage: mkbundle OUT ROOT [--font PATH]... [--atlas NAME PX TEXT]... [--atlas-size N]\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) { usage(); return 2; }
+    const fs::path out = argv[1];
+    const fs::path root = argv[2];
+    std::vector<fs::path> fonts;
+    std::vector<AtlasJob> atlases;
+    int atlasSize = 2048;
+    for (int i = 3; i < argc; i++) {
+        const std::string a = argv[i];
+        if (a == "--font" && i + 1 < argc) {
+            fonts.emplace_back(argv[++i]);
+        } else if (a == "--atlas" && i + 3 < argc) {
+            AtlasJob j;
+            j.font = argv[++i];
+            j.px = std::atoi(argv[++i]);
+            j.text = argv[++i];
+            atlases.push_back(std::move(j));
+        } else if (a == "--atlas-size" && i + 1 < argc) {
+            atlasSize = std::atoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    Assets::BundleWriter w;
+    std::error_code ec;
+    std::vector<fs::path> files;
+    for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_regular_file(ec)) files.push_back(it->path());
+    }
+    if (ec) {
+        std::fprintf(stderr, "mkbundle: cannot list %s: %s\n", root.c_str(), ec.message().c_str());
+        return 1;
+    }
+    std::sort(files.begin(), files.end());
+    for (const fs::path& p : files) {
+        // an older bundle in the same tree
+        if (p.filename() == Assets::kBundleName || fs::equivalent(p, out, ec)) continue;
+        std::vector<uint8_t> data;
+        if (!readFile(p, data)) {
+            std::fprintf(stderr, "mkbundle: cannot read %s\n", p.c_str());
+            return 1;
+        }
+        w.add(p.lexically_relative(root).generic_string(), std::move(data));
+    }
+    for (const fs::path& p : fonts) {
+        std::vector<uint8_t> data;
+        if (!readFile(p, data)) {
+            std::fprintf(stderr, "mkbundle: cannot read font %s\n", p.c_str());
+            return 1;
+        }
+        w.add("fonts/" + p.filename().string(), std::move(data));
+    }
+
+    for (const AtlasJob& j : atlases) {
+        std::vector<uint8_t> bytes;
+        const fs::path src = root / "fonts" / j.font;
+        const auto it = std::find_if(fonts.begin(), fonts.end(), [&](const fs::path& p) { return p.filename() == j.font; });
+        if (!readFile(it != fonts.end() ? *it : src, bytes)) {
+            std::fprintf(stderr, "mkbundle: --atlas: fonts/%s is not in the bundle\n", j.font.c_str());
+            return 1;
+        }
+        Assets::Font font;
+        font.bytes.assign(bytes.begin(), bytes.end());
+        TextShaper shaper;
+        std::vector<uint8_t> blob;
+        if (!shaper.init(std::move(font), j.px, atlasSize, atlasSize) ||
+            !shaper.prewarm(j.text.c_str()) || !shaper.saveAtlas(blob)) {
+            std::fprintf(stderr, "mkbundle: --atlas %s %d failed\n", j.font.c_str(), j.px);
+            return 1;
+        }
+        w.add(Assets::atlasName(j.font, j.px), std::move(blob), Assets::BundleKind::GlyphAtlas);
+    }
+
+    if (!w.write(out.string())) {
+        std::fprintf(stderr, "mkbundle: cannot write %s\n", out.c_str());
+        return 1;
+    }
+    std::printf("%s: %zu files, %zu fonts, %zu atlases\n", out.c_str(), files.size(), fonts.size(), atlases.size());
+    return 0;
+}